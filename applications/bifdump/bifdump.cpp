@@ -1,127 +1,729 @@
 #include <BifrostHeaders.h>
+#include <utils/BifrostUtils.h>
 #include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
 
-void perform_dump(const Bifrost::API::Layout&  layout,
-                  const Bifrost::API::Channel& ch)
+namespace po = boost::program_options;
+
+typedef std::vector<std::string> StringContainer;
+typedef std::vector<Bifrost::API::TreeIndex> TreeIndexContainer;
+
+//! stdio buffer size, values are written a tile at a time
+const size_t WRITE_BUFFER_SIZE = 4 << 20;
+//! elements formatted per parallel batch, bounds the memory of the text buffers
+const size_t FORMAT_BATCH_ELEMENTS = 4 << 20;
+
+enum DumpFormat { TextFormat, CSVFormat, RawFormat, NumpyFormat };
+
+/*!
+ * \brief Command line choices shared by every channel dump
+ */
+struct DumpOptions
 {
-    // iterate over the tile tree at each level
-    Bifrost::API::DataType channelDataType = ch.dataType();
+    DumpOptions() : format(TextFormat), output_dir("."), stats(false), bins(16) {}
+    DumpFormat format;
+    std::string output_dir;
+    bool stats; //!< summarize the channels instead of dumping their values
+    size_t bins; //!< histogram bins of the statistics
+    std::set<std::string> channels; //!< empty dumps every channel
+    std::set<size_t> depths; //!< empty dumps every depth
+    std::set<size_t> tiles; //!< empty dumps every tile
+};
+
+/*!
+ * \brief NumPy type code of a channel scalar
+ */
+template<typename S> struct NumpyKind;
+template<> struct NumpyKind<float> { static char kind() { return 'f'; } };
+template<> struct NumpyKind<int8_t> { static char kind() { return 'i'; } };
+template<> struct NumpyKind<int16_t> { static char kind() { return 'i'; } };
+template<> struct NumpyKind<int32_t> { static char kind() { return 'i'; } };
+template<> struct NumpyKind<int64_t> { static char kind() { return 'i'; } };
+template<> struct NumpyKind<uint8_t> { static char kind() { return 'u'; } };
+template<> struct NumpyKind<uint16_t> { static char kind() { return 'u'; } };
+template<> struct NumpyKind<uint32_t> { static char kind() { return 'u'; } };
+template<> struct NumpyKind<uint64_t> { static char kind() { return 'u'; } };
+template<> struct NumpyKind<bool> { static char kind() { return 'b'; } };
+
+/*!
+ * \brief Shortest decimal text reading back as the same float
+ *
+ * Tries increasing precisions up to the 9 significant digits which always
+ * round trip a float.
+ */
+inline void append_value(std::string& o_buffer, float value)
+{
+    char text[32];
+    int length = 0;
+    if (!std::isfinite(value))
+    {
+        length = snprintf(text, sizeof(text), "%g", value);
+    }
+    else
+    {
+        for (int precision=6; precision<=9; precision++)
+        {
+            length = snprintf(text, sizeof(text), "%.*g", precision, value);
+            if (strtof(text, NULL) == value)
+                break;
+        }
+    }
+    o_buffer.append(text, length);
+}
+
+inline void append_value(std::string& o_buffer, int64_t value)
+{
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%lld", static_cast<long long>(value));
+    o_buffer.append(text, length);
+}
+
+inline void append_value(std::string& o_buffer, uint64_t value)
+{
+    char text[32];
+    int length = snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(value));
+    o_buffer.append(text, length);
+}
+
+// Small integers are printed as numbers, not characters
+inline void append_value(std::string& o_buffer, int8_t value) { append_value(o_buffer, int64_t(value)); }
+inline void append_value(std::string& o_buffer, int16_t value) { append_value(o_buffer, int64_t(value)); }
+inline void append_value(std::string& o_buffer, int32_t value) { append_value(o_buffer, int64_t(value)); }
+inline void append_value(std::string& o_buffer, uint8_t value) { append_value(o_buffer, uint64_t(value)); }
+inline void append_value(std::string& o_buffer, uint16_t value) { append_value(o_buffer, uint64_t(value)); }
+inline void append_value(std::string& o_buffer, uint32_t value) { append_value(o_buffer, uint64_t(value)); }
+inline void append_value(std::string& o_buffer, bool value) { o_buffer.push_back(value ? '1' : '0'); }
+
+/*!
+ * \brief Channel name usable as a file name
+ */
+std::string file_safe_name(const std::string& i_name)
+{
+    std::string name(i_name);
+    for (size_t i=0;i<name.size();i++)
+        if (name[i] == '/' || name[i] == '\\' || name[i] == ':' || name[i] == ' ')
+            name[i] = '_';
+    return name;
+}
+
+/*!
+ * \brief Is the channel selected by --channel, either by its full name or
+ *        by the part after the component name
+ */
+bool channel_selected(const DumpOptions& i_options, const std::string& i_name)
+{
+    if (i_options.channels.empty())
+        return true;
+    if (i_options.channels.count(i_name))
+        return true;
+    return i_options.channels.count(channel_short_name(i_name)) > 0;
+}
+
+/*!
+ * \brief Non empty tiles of the channel which pass the depth and tile filters
+ */
+size_t select_tiles(const DumpOptions& i_options,
+                    const Bifrost::API::Layout& layout,
+                    const Bifrost::API::Channel& ch,
+                    TreeIndexContainer& o_tiles)
+{
+    size_t element_count = 0;
+    o_tiles.clear();
     size_t depthCount = layout.depthCount();
     for ( size_t d=0; d<depthCount; d++ ) {
+        if (!i_options.depths.empty() && !i_options.depths.count(d))
+            continue;
         for ( size_t t=0; t<layout.tileCount(d); t++ ) {
+            if (!i_options.tiles.empty() && !i_options.tiles.count(t))
+                continue;
             Bifrost::API::TreeIndex tindex(t,d);
-            if ( !ch.elementCount( tindex ) ) {
+            size_t count = ch.elementCount( tindex );
+            if ( !count ) {
                 // nothing there
                 continue;
             }
-            std::cout << "tile:" << t << " depth:" << d << std::endl;
-            switch (channelDataType)
+            o_tiles.push_back(tindex);
+            element_count += count;
+        }
+    }
+    return element_count;
+}
+
+/*!
+ * \brief Version 1.0 NumPy header of a C ordered array of element_count
+ *        rows of arity scalars, padded to a multiple of 64 bytes
+ */
+template<typename S>
+std::string numpy_header(size_t element_count, size_t arity)
+{
+    const uint16_t endian_probe = 1;
+    const bool little_endian = *reinterpret_cast<const uint8_t*>(&endian_probe) == 1;
+    std::string shape = arity == 1
+        ? (boost::format("(%1%,)") % element_count).str()
+        : arity == 16
+        ? (boost::format("(%1%, 4, 4)") % element_count).str()
+        : (boost::format("(%1%, %2%)") % element_count % arity).str();
+    std::string dict = (boost::format("{'descr': '%1%%2%%3%', 'fortran_order': False, 'shape': %4%, }")
+                        % (sizeof(S) == 1 ? '|' : (little_endian ? '<' : '>'))
+                        % NumpyKind<S>::kind()
+                        % sizeof(S)
+                        % shape).str();
+    const size_t preamble = 10; // magic, version and header length
+    size_t padded = preamble + dict.size() + 1;
+    padded = (padded + 63) / 64 * 64;
+    dict.append(padded - preamble - dict.size() - 1, ' ');
+    dict.push_back('\n');
+
+    std::string header("\x93NUMPY\x01\x00", 8);
+    const uint16_t header_length = static_cast<uint16_t>(dict.size());
+    header.push_back(static_cast<char>(header_length & 0xff));
+    header.push_back(static_cast<char>(header_length >> 8));
+    return header + dict;
+}
+
+/*!
+ * \brief Text of the values of one tile, one element per line
+ */
+template<typename S, size_t N>
+void format_tile(DumpFormat format,
+                 const Bifrost::API::TreeIndex& tindex,
+                 const S* values,
+                 size_t count,
+                 std::string& o_buffer)
+{
+    o_buffer.clear();
+    if (format == TextFormat)
+        o_buffer += (boost::format("tile:%1% depth:%2%\n") % tindex.tile % tindex.depth).str();
+    const std::string prefix = format == CSVFormat
+        ? (boost::format("%1%,%2%,") % tindex.depth % tindex.tile).str()
+        : std::string("\t");
+    const char separator = format == CSVFormat ? ',' : ' ';
+    o_buffer.reserve(o_buffer.size() + count * (prefix.size() + N * 12));
+    for (size_t i=0; i<count; i++ ) {
+        o_buffer += prefix;
+        for (size_t c=0; c<N; c++ ) {
+            if (c)
+                o_buffer.push_back(separator);
+            append_value(o_buffer, values[i*N + c]);
+        }
+        o_buffer.push_back('\n');
+    }
+    if (format == TextFormat)
+        o_buffer.push_back('\n');
+}
+
+/*!
+ * \brief Moments and extremes of one scalar component of a channel, NaN
+ *        and infinite values are counted but left out of the moments
+ */
+struct ScalarStats
+{
+    ScalarStats()
+    : count(0)
+    , nan_count(0)
+    , inf_count(0)
+    , min(std::numeric_limits<double>::max())
+    , max(-std::numeric_limits<double>::max())
+    , mean(0.0)
+    , m2(0.0)
+    {}
+    //! Chan et al. pairwise combination of the means and squared deviations
+    void merge(const ScalarStats& other)
+    {
+        if (!other.count)
+        {
+            nan_count += other.nan_count;
+            inf_count += other.inf_count;
+            return;
+        }
+        const size_t total = count + other.count;
+        const double delta = other.mean - mean;
+        mean += delta * other.count / total;
+        m2 += other.m2 + delta * delta * (static_cast<double>(count) * other.count / total);
+        count = total;
+        nan_count += other.nan_count;
+        inf_count += other.inf_count;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+    double variance() const { return count ? m2 / count : 0.0; }
+    size_t count;
+    size_t nan_count;
+    size_t inf_count;
+    double min;
+    double max;
+    double mean;
+    double m2; //!< sum of squared deviations from the mean
+};
+typedef std::vector<ScalarStats> ScalarStatsContainer;
+typedef std::vector<size_t> HistogramContainer;
+
+/*!
+ * \brief Scalar components of element i, followed by their length when
+ *        o_values has room for it
+ */
+template<typename S, size_t N, size_t M>
+inline void stats_values(const S* values, size_t i, double (&o_values)[M])
+{
+    double length2 = 0.0;
+    for (size_t k=0; k<N; k++)
+    {
+        o_values[k] = static_cast<double>(values[i*N + k]);
+        length2 += o_values[k] * o_values[k];
+    }
+    if (M > N)
+        o_values[M-1] = sqrt(length2);
+}
+
+/*!
+ * \brief 1 for a finite value, 0 for NaN or infinite, x - x is only 0
+ *        for finite values
+ */
+inline double finite_mask(double value)
+{
+    return (value - value == 0.0) ? 1.0 : 0.0;
+}
+
+/*!
+ * \brief Statistics of the tiles of a channel, per scalar component and for
+ *        float vectors also of their length
+ *
+ * Two parallel passes over the tiles. The first reduces the moments, each
+ * tile is summed in one loop over its elements updating every component,
+ * shifted by the first element of the tile so the squared deviations keep
+ * their precision. The histogram spans the final min and max so it is the
+ * second pass, over tile data already in memory. Non finite values are
+ * masked out with selects rather than branches so the loops stay tight.
+ */
+template<typename T, typename S, size_t N>
+bool stats_typed(const DumpOptions& i_options,
+                 const Bifrost::API::Layout& layout,
+                 const Bifrost::API::Channel& ch)
+{
+    TreeIndexContainer tiles;
+    select_tiles(i_options, layout, ch, tiles);
+    // Float vectors also get the statistics of their length
+    static const size_t M = (N > 1 && N <= 4 && std::is_floating_point<S>::value) ? N + 1 : N;
+    const size_t stats_count = M;
+
+    ScalarStatsContainer stats = tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, tiles.size()),
+        ScalarStatsContainer(stats_count),
+        [&](const tbb::blocked_range<size_t>& r, ScalarStatsContainer partial) -> ScalarStatsContainer
+        {
+            for (size_t t=r.begin(); t!=r.end(); ++t)
             {
-            case Bifrost::API::FloatType :
+                const Bifrost::API::TileData<T>& tile_data = ch.tileData<T>( tiles[t] );
+                const size_t count = tile_data.count();
+                if (!count)
+                    continue;
+                const S* values = reinterpret_cast<const S*>(&tile_data[0]);
+                double shift[M], finite_count[M], nan_count[M], sum[M], sum2[M], min[M], max[M];
+                double value[M];
+                stats_values<S,N>(values, 0, value);
+                for (size_t c=0; c<M; c++)
+                {
+                    shift[c] = finite_mask(value[c]) ? value[c] : 0.0;
+                    finite_count[c] = nan_count[c] = sum[c] = sum2[c] = 0.0;
+                    min[c] = std::numeric_limits<double>::max();
+                    max[c] = -std::numeric_limits<double>::max();
+                }
+                for (size_t i=0; i<count; i++)
                 {
-                    const Bifrost::API::TileData<float>& f1 = ch.tileData<float>( tindex );
-                    for (size_t i=0; i<f1.count(); i++ ) {
-                        const float& val = f1[i];
-                        std::cout << "\t" << f1[i] << std::endl;
+                    stats_values<S,N>(values, i, value);
+                    for (size_t c=0; c<M; c++)
+                    {
+                        const double finite = finite_mask(value[c]);
+                        const double delta = finite ? value[c] - shift[c] : 0.0;
+                        finite_count[c] += finite;
+                        nan_count[c] += (value[c] != value[c]) ? 1.0 : 0.0;
+                        sum[c] += delta;
+                        sum2[c] += delta * delta;
+                        min[c] = std::min(min[c], finite ? value[c] : min[c]);
+                        max[c] = std::max(max[c], finite ? value[c] : max[c]);
                     }
-
-                    std::cout << std::endl;
                 }
-                break;
-            case Bifrost::API::FloatV2Type :
-                break;
-            case Bifrost::API::FloatV3Type :
+                for (size_t c=0; c<stats_count; c++)
                 {
-                    const Bifrost::API::TileData<amino::Math::vec3f>& f3 = ch.tileData<amino::Math::vec3f>( tindex );
-                    for (size_t i=0; i<f3.count(); i++ ) {
-                        const amino::Math::vec3f& val = f3[i];
-                        std::cout << "\t" << val[0] << " " << val[1] << " " << val[2] << std::endl;
+                    ScalarStats tile_stats;
+                    tile_stats.count = static_cast<size_t>(finite_count[c]);
+                    tile_stats.nan_count = static_cast<size_t>(nan_count[c]);
+                    tile_stats.inf_count = count - tile_stats.count - tile_stats.nan_count;
+                    if (tile_stats.count)
+                    {
+                        tile_stats.mean = shift[c] + sum[c] / tile_stats.count;
+                        tile_stats.m2 = std::max(sum2[c] - sum[c] * sum[c] / tile_stats.count, 0.0);
+                        tile_stats.min = min[c];
+                        tile_stats.max = max[c];
                     }
+                    partial[c].merge(tile_stats);
+                }
+            }
+            return partial;
+        },
+        [](ScalarStatsContainer a, const ScalarStatsContainer& b) -> ScalarStatsContainer
+        {
+            for (size_t c=0; c<a.size(); c++)
+                a[c].merge(b[c]);
+            return a;
+        });
 
-                    std::cout << std::endl;
+    const size_t bins = std::max<size_t>(i_options.bins, 1);
+    double bin_min[M], bin_scale[M];
+    for (size_t c=0; c<M; c++)
+    {
+        const bool used = stats[c].count > 0;
+        const double range = used ? stats[c].max - stats[c].min : 0.0;
+        bin_min[c] = used ? stats[c].min : 0.0;
+        bin_scale[c] = range > 0.0 ? bins / range : 0.0;
+    }
+    HistogramContainer histogram = tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, tiles.size()),
+        HistogramContainer(M * bins, 0),
+        [&](const tbb::blocked_range<size_t>& r, HistogramContainer partial) -> HistogramContainer
+        {
+            double value[M];
+            for (size_t t=r.begin(); t!=r.end(); ++t)
+            {
+                const Bifrost::API::TileData<T>& tile_data = ch.tileData<T>( tiles[t] );
+                const size_t count = tile_data.count();
+                if (!count)
+                    continue;
+                const S* values = reinterpret_cast<const S*>(&tile_data[0]);
+                for (size_t i=0; i<count; i++)
+                {
+                    stats_values<S,N>(values, i, value);
+                    for (size_t c=0; c<M; c++)
+                    {
+                        // Non finite values land in bin 0 with a weight of 0
+                        const double finite = finite_mask(value[c]);
+                        const double offset = finite ? (value[c] - bin_min[c]) * bin_scale[c] : 0.0;
+                        const size_t bin = std::min(static_cast<size_t>(offset), bins - 1);
+                        partial[c * bins + bin] += static_cast<size_t>(finite);
+                    }
                 }
-                break;
-            case Bifrost::API::Int32Type :
-                break;
-            case Bifrost::API::Int64Type :
-                break;
-            case Bifrost::API::UInt32Type :
-                break;
-            case Bifrost::API::UInt64Type :
-                break;
-            case Bifrost::API::Int32V2Type :
-                break;
-            case Bifrost::API::Int32V3Type :
-                break;
-            default:
-                std::cerr << "Unknown channel type encountered" << std::endl;
-                break;
             }
+            return partial;
+        },
+        [](HistogramContainer a, const HistogramContainer& b) -> HistogramContainer
+        {
+            for (size_t i=0; i<a.size(); i++)
+                a[i] += b[i];
+            return a;
+        });
+
+    for (size_t c=0; c<stats_count; c++)
+    {
+        const ScalarStats& component = stats[c];
+        const std::string label = c < N ? (boost::format("[%1%]") % c).str() : std::string("length");
+        if (!component.count)
+        {
+            std::cout << boost::format("		%1% no finite value, nan %2% inf %3%")
+                % label % component.nan_count % component.inf_count << std::endl;
+            continue;
         }
+        std::cout << boost::format("		%1% count %2% min %3% max %4% mean %5% variance %6% stddev %7% nan %8% inf %9%")
+            % label % component.count % component.min % component.max % component.mean
+            % component.variance() % sqrt(component.variance())
+            % component.nan_count % component.inf_count << std::endl;
+        std::cout << boost::format("		%1% histogram of %2% bins :") % label % bins;
+        for (size_t b=0; b<bins; b++)
+            std::cout << " " << histogram[c * bins + b];
+        std::cout << std::endl;
     }
+    return true;
 }
 
-int main(int argc, char **argv)
+/*!
+ * \brief Dump a channel whose tile data elements are T, made of N
+ *        scalars of type S, or print its statistics with --stats
+ */
+template<typename T, typename S, size_t N>
+bool dump_typed(const DumpOptions& i_options,
+                const std::string& i_component_name,
+                const Bifrost::API::Layout& layout,
+                const Bifrost::API::Channel& ch)
+{
+    if (i_options.stats)
+        return stats_typed<T,S,N>(i_options, layout, ch);
+
+    TreeIndexContainer tiles;
+    const size_t element_count = select_tiles(i_options, layout, ch, tiles);
+    const std::string channel_name = ch.name().c_str();
+
+    FILE* output = stdout;
+    std::string output_path;
+    if (i_options.format != TextFormat)
+    {
+        const char* extension = i_options.format == CSVFormat ? "csv" : i_options.format == RawFormat ? "raw" : "npy";
+        output_path = (boost::format("%1%/%2%.%3%.%4%")
+                       % i_options.output_dir
+                       % file_safe_name(i_component_name)
+                       % file_safe_name(channel_name)
+                       % extension).str();
+        output = fopen(output_path.c_str(), "wb");
+        if (!output)
+        {
+            std::cerr << boost::format("bifdump : unable to open \"%1%\" for writing") % output_path << std::endl;
+            return false;
+        }
+        setvbuf(output, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+    }
+
+    std::string header;
+    if (i_options.format == NumpyFormat)
+    {
+        header = numpy_header<S>(element_count, N);
+    }
+    else if (i_options.format == CSVFormat)
+    {
+        header = "depth,tile";
+        const std::string column = file_safe_name(channel_name);
+        for (size_t c=0; c<N; c++)
+            header += N == 1 ? "," + column : (boost::format(",%1%_%2%") % column % c).str();
+        header.push_back('\n');
+    }
+    fwrite(header.data(), 1, header.size(), output);
+
+    bool status = true;
+    if (i_options.format == RawFormat || i_options.format == NumpyFormat)
+    {
+        for (size_t i=0; i<tiles.size() && status; i++)
+        {
+            const Bifrost::API::TileData<T>& tile_data = ch.tileData<T>( tiles[i] );
+            const size_t count = tile_data.count();
+            if (count)
+                status = fwrite(&tile_data[0], sizeof(T), count, output) == count;
+        }
+    }
+    else
+    {
+        // Tiles of a batch are formatted in parallel then written in tile order
+        std::vector<std::string> tile_buffers;
+        size_t batch_begin = 0;
+        while (batch_begin < tiles.size() && status)
+        {
+            size_t batch_end = batch_begin;
+            size_t batch_elements = 0;
+            while (batch_end < tiles.size() && (batch_end == batch_begin || batch_elements < FORMAT_BATCH_ELEMENTS))
+                batch_elements += ch.elementCount( tiles[batch_end++] );
+            tile_buffers.resize(batch_end - batch_begin);
+            tbb::parallel_for(tbb::blocked_range<size_t>(batch_begin,batch_end),
+                [&](const tbb::blocked_range<size_t>& r)
+                {
+                    for (size_t i=r.begin(); i!=r.end(); ++i)
+                    {
+                        const Bifrost::API::TileData<T>& tile_data = ch.tileData<T>( tiles[i] );
+                        std::string& tile_buffer = tile_buffers[i - batch_begin];
+                        tile_buffer.clear();
+                        if (tile_data.count())
+                            format_tile<S,N>(i_options.format, tiles[i], reinterpret_cast<const S*>(&tile_data[0]), tile_data.count(), tile_buffer);
+                    }
+                });
+            for (size_t i=0; i<tile_buffers.size() && status; i++)
+                status = fwrite(tile_buffers[i].data(), 1, tile_buffers[i].size(), output) == tile_buffers[i].size();
+            batch_begin = batch_end;
+        }
+    }
+
+    if (output != stdout)
+    {
+        status = (fclose(output) == 0) && status;
+        if (status)
+            std::cout << boost::format("\t\twrote %1% elements to %2%") % element_count % output_path << std::endl;
+        else
+            std::cerr << boost::format("bifdump : error writing \"%1%\"") % output_path << std::endl;
+    }
+    return status;
+}
+
+bool perform_dump(const DumpOptions& i_options,
+                  const std::string& i_component_name,
+                  const Bifrost::API::Layout&  layout,
+                  const Bifrost::API::Channel& ch)
 {
-    if (argc != 2)
+    Bifrost::API::DataType channelDataType = ch.dataType();
+    switch (channelDataType)
     {
-        fprintf(stderr,"Usage : %s <bifrost file>\n",argv[0]);
+    case Bifrost::API::FloatType :
+        return dump_typed<float,float,1>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::FloatV2Type :
+        return dump_typed<amino::Math::vec2f,float,2>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::FloatV3Type :
+        return dump_typed<amino::Math::vec3f,float,3>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::Int32Type :
+        return dump_typed<int32_t,int32_t,1>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::Int64Type :
+        return dump_typed<int64_t,int64_t,1>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::UInt32Type :
+        return dump_typed<uint32_t,uint32_t,1>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::UInt64Type :
+        return dump_typed<uint64_t,uint64_t,1>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::Int32V2Type :
+        return dump_typed<amino::Math::vec2i,int32_t,2>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::Int32V3Type :
+        return dump_typed<amino::Math::vec3i,int32_t,3>(i_options, i_component_name, layout, ch);
+#if BIFROST_VERSION >= 20
+    case Bifrost::API::FloatV4Type :
+        return dump_typed<amino::Math::vec4f,float,4>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::FloatMat44Type :
+        return dump_typed<amino::Math::mat44f,float,16>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::Int8Type :
+        return dump_typed<int8_t,int8_t,1>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::Int16Type :
+        return dump_typed<int16_t,int16_t,1>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::UInt8Type :
+        return dump_typed<uint8_t,uint8_t,1>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::UInt16Type :
+        return dump_typed<uint16_t,uint16_t,1>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::BoolType :
+        return dump_typed<bool,bool,1>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::UInt64V2Type :
+        return dump_typed<amino::Math::vec2ui64,uint64_t,2>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::UInt64V3Type :
+        return dump_typed<amino::Math::vec3ui64,uint64_t,3>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::UInt64V4Type :
+        return dump_typed<amino::Math::vec4ui64,uint64_t,4>(i_options, i_component_name, layout, ch);
+    case Bifrost::API::StringClassType :
+    case Bifrost::API::DictionaryClassType :
+    case Bifrost::API::StringArrayClassType :
+        std::cerr << boost::format("bifdump : channel %1% holds objects, not values, skipped") % ch.name().c_str() << std::endl;
+        return true;
+#endif // BIFROST_VERSION >= 20
+    default:
+        std::cerr << "Unknown channel type encountered" << std::endl;
+        break;
+    }
+    return false;
+}
+
+/*!
+ * \brief Dump the selected channels of a component
+ */
+bool dump_component(const DumpOptions& i_options,
+                    const Bifrost::API::Component& component,
+                    const char* i_element_label)
+{
+    bool status = true;
+    const std::string component_name = component.name().c_str();
+    Bifrost::API::Layout layout = component.layout();
+    Bifrost::API::RefArray channels = component.channels();
+    size_t channelCount = channels.count();
+    for (size_t channelIndex=0;channelIndex<channelCount;channelIndex++)
+    {
+        const Bifrost::API::Channel& ch = channels[channelIndex];
+        Bifrost::API::String channelName = ch.name();
+        if (!channel_selected(i_options, channelName.c_str()))
+            continue;
+        Bifrost::API::DataType channelDataType = ch.dataType();
+        std::cout << boost::format("\tChannel[%1%] of type %2% : %3% has %4% %5%")
+            % channelIndex % channelDataType % channelName.c_str() % ch.elementCount() % i_element_label << std::endl;
+        status = perform_dump(i_options, component_name, layout, ch) && status;
+    }
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    DumpOptions options;
+    std::string bif_filename;
+    try {
+        std::string format("text");
+        StringContainer channels;
+        std::vector<size_t> depths;
+        std::vector<size_t> tiles;
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            ("help", "produce help message")
+            ("bif", po::value<std::string>(&bif_filename), "bifrost file")
+            ("format", po::value<std::string>(&format), "text (stdout), csv, raw or npy (one file per channel)")
+            ("output-dir", po::value<std::string>(&options.output_dir), "directory of the per channel files")
+            ("channel", po::value<StringContainer>(&channels), "dump only this channel, full name or name within the component, repeatable")
+            ("depth", po::value< std::vector<size_t> >(&depths), "dump only the tiles of this depth, repeatable")
+            ("tile", po::value< std::vector<size_t> >(&tiles), "dump only this tile index, repeatable")
+            ("stats", "print per channel min, max, mean, variance, NaN/Inf counts and histogram instead of the values")
+            ("bins", po::value<size_t>(&options.bins), "number of histogram bins of --stats")
+            ;
+        po::positional_options_description positional;
+        positional.add("bif", 1);
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+        po::notify(vm);
+        if (vm.count("help") || bif_filename.empty())
+        {
+            std::cerr << boost::format("Usage : %1% [options] <bifrost file>") % argv[0] << std::endl;
+            std::cerr << desc << std::endl;
+            exit(vm.count("help") ? 0 : 1);
+        }
+        if (format == "text")
+            options.format = TextFormat;
+        else if (format == "csv")
+            options.format = CSVFormat;
+        else if (format == "raw")
+            options.format = RawFormat;
+        else if (format == "npy")
+            options.format = NumpyFormat;
+        else
+            throw std::runtime_error((boost::format("unknown format \"%1%\"") % format).str());
+        options.stats = vm.count("stats") > 0;
+        options.channels.insert(channels.begin(), channels.end());
+        options.depths.insert(depths.begin(), depths.end());
+        options.tiles.insert(tiles.begin(), tiles.end());
+    }
+    catch(std::exception& e) {
+        std::cerr << boost::format("bifdump : %1%") % e.what() << std::endl;
         exit(1);
     }
-    Bifrost::API::String biffile = argv[1];
+
+    // Large writes, the values are never flushed line by line
+    setvbuf(stdout, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+
+    Bifrost::API::String biffile = bif_filename.c_str();
     Bifrost::API::ObjectModel om;
     Bifrost::API::FileIO fileio = om.createFileIO( biffile );
     Bifrost::API::StateServer ss = fileio.load( );
 
     if ( !ss.valid() ) {
-        std::cerr << "bifinfo : file loading error" << std::endl;
+        std::cerr << "bifdump : file loading error" << std::endl;
         exit(1);
     }
 
+    bool status = true;
     size_t numComponents = ss.components().count();
     std::cout << "Number of components : " << numComponents << std::endl;
     for (size_t i=0;i<numComponents;i++)
     {
         Bifrost::API::Component component = ss.components()[i];
         Bifrost::API::TypeID componentType = component.type();
-        Bifrost::API::Layout layout = component.layout();
         if (componentType == Bifrost::API::PointComponentType)
         {
             std::cout << "Point component : "
                     << component.name().c_str()
                     << std::endl;
-
-            Bifrost::API::RefArray channels = component.channels();
-            size_t particleCount = component.elementCount();
-            size_t channelCount = channels.count();
-            for (size_t channelIndex=0;channelIndex<channelCount;channelIndex++)
-            {
-                const Bifrost::API::Channel& ch = channels[channelIndex];
-                Bifrost::API::String channelName = ch.name();
-                Bifrost::API::DataType channelDataType = ch.dataType();
-                std::cout << boost::format("\tChannel[%1%] of type %2% : %3% has %4% particles")
-                % channelIndex % channelDataType % channelName.c_str() % channelCount << std::endl;
-                perform_dump(layout,ch);
-            }
+            status = dump_component(options, component, "particles") && status;
         }
         else if (componentType == Bifrost::API::VoxelComponentType)
         {
             std::cout << "Voxel component : "
                     << component.name().c_str()
                     << std::endl;
-            Bifrost::API::RefArray channels = component.channels();
-            size_t channelCount = channels.count();
-            for (size_t channelIndex=0;channelIndex<channelCount;channelIndex++)
-            {
-                const Bifrost::API::Channel& ch = channels[channelIndex];
-                Bifrost::API::String channelName = ch.name();
-                Bifrost::API::DataType channelDataType = ch.dataType();
-                std::cout << boost::format("\tChannel[%1%] of type %2% : %3% has %4% voxels")
-                % channelIndex % channelDataType % channelName.c_str() % channelCount << std::endl;
-                perform_dump(layout,ch);
-            }
+            status = dump_component(options, component, "voxels") && status;
         }
     }
 
-    exit(0);
+    fflush(stdout);
+    exit(status ? 0 : 1);
 }
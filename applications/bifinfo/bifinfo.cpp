@@ -1,6 +1,9 @@
 #include <utils/BifrostUtils.h>
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_reduce.h>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
@@ -493,61 +496,248 @@ int process_bifrost_voxel(const std::string& bifrost_filename)
 	return 0;
 }
 
-int process_bifrost_voxel_autodesk(const std::string& bifrost_filename)
+/*!
+ * \brief Size in bytes of one element of a channel, 0 for the object
+ *        channels whose elements have no fixed size
+ */
+size_t channel_element_bytes(Bifrost::API::DataType data_type)
 {
-	using namespace Bifrost::API;
-
-	String biffile = bifrost_filename.c_str();
-	ObjectModel om;
-	FileIO fileio = om.createFileIO(biffile);
-	StateServer ss = fileio.load();
-	std::cout << "00000" << std::endl;
-	if (ss) {
-		std::cout << "01000" << std::endl;
-		// traverse the tree and iterate tile children
-		RefArray layouts = ss.layouts();
-		Layout layout = layouts[0];
-		TileAccessor tacc = layout.tileAccessor();
-		size_t depth = layout.maxDepth();
-		TileIterator it = layout.tileIterator(depth, depth, BreadthFirst);
-
-		while (it) {
-			std::cout << "02000" << std::endl;
-			// Get tile info to access children
-			Tile tile = *it;
-			TreeIndex itIndex = it.index();
-			TreeIndex tindex = tile.index();
-			TileInfo info = tile.info();
-		
-			// access children with i,j,k coordinates
-			if (info.hasChildren) {
-				std::cout << "03000" << std::endl;
-				TileDimInfo dinfo = info.dimInfo;
-				for (int i = 0; i<dinfo.tileWidth; i++) {
-					for (int j = 0; j<dinfo.tileWidth; j++) {
-						for (int k = 0; k<dinfo.tileWidth; k++) {
-							std::cout << "04000" << std::endl;
-							TreeIndex cindex = tile.child(i, j, k);
-
-							// log the child tile info
-							if (cindex.valid()) {
-								Tile child = tacc.tile(cindex);
-								TileInfo cinfo = child.info();
-
-								std::cout << "tile id: " << cinfo.id << std::endl;
-								std::cout << "	tile is valid: " << cinfo.valid << std::endl;
-								std::cout << "	tile space coordinates: " << cinfo.i << ", " << cinfo.j << ", " << cinfo.k << std::endl;
-								std::cout << "	tile index: " << cinfo.tile << ":" << cinfo.depth << std::endl;
-								std::cout << "	tile parent: " << cinfo.parent << std::endl;
-								std::cout << "	tile has children: " << cinfo.hasChildren << std::endl;
-							}
-						}
+	switch (data_type)
+	{
+	case Bifrost::API::FloatType:
+	case Bifrost::API::Int32Type:
+	case Bifrost::API::UInt32Type:
+		return 4;
+	case Bifrost::API::FloatV2Type:
+	case Bifrost::API::Int32V2Type:
+	case Bifrost::API::Int64Type:
+	case Bifrost::API::UInt64Type:
+		return 8;
+	case Bifrost::API::FloatV3Type:
+	case Bifrost::API::Int32V3Type:
+		return 12;
+#if BIFROST_VERSION >= 20
+	case Bifrost::API::FloatV4Type:
+	case Bifrost::API::UInt64V2Type:
+		return 16;
+	case Bifrost::API::UInt64V3Type:
+		return 24;
+	case Bifrost::API::UInt64V4Type:
+		return 32;
+	case Bifrost::API::FloatMat44Type:
+		return 64;
+	case Bifrost::API::Int8Type:
+	case Bifrost::API::UInt8Type:
+	case Bifrost::API::BoolType:
+		return 1;
+	case Bifrost::API::Int16Type:
+	case Bifrost::API::UInt16Type:
+		return 2;
+#endif // BIFROST_VERSION >= 20
+	default:
+		return 0;
+	}
+}
+
+/*!
+ * \brief Occupancy of the tiles of one depth of a layout
+ */
+struct DepthOccupancy
+{
+	DepthOccupancy(size_t channel_count = 0)
+		: tiles(0), occupied_tiles(0), allocated_elements(0), active_voxels(0), channel_elements(channel_count, 0) {}
+	void merge(const DepthOccupancy& other)
+	{
+		tiles += other.tiles;
+		occupied_tiles += other.occupied_tiles;
+		allocated_elements += other.allocated_elements;
+		active_voxels += other.active_voxels;
+		for (size_t c = 0; c < channel_elements.size(); c++)
+			channel_elements[c] += other.channel_elements[c];
+	}
+	size_t tiles;
+	size_t occupied_tiles; //!< tiles where at least one channel has elements
+	size_t allocated_elements; //!< per tile, the element count of its fullest channel
+	size_t active_voxels; //!< voxels of the activity channel holding a value
+	std::vector<size_t> channel_elements;
+};
+
+/*!
+ * \brief Float channel telling which voxels hold a value, i_name when given
+ *        otherwise density or else distance
+ * \return the channel index, -1 if the component has none of them
+ */
+int find_activity_channel(const Bifrost::API::Component& component,
+						  const std::string& i_name)
+{
+	const char* names[] = { "density", "distance" };
+	const size_t name_count = i_name.empty() ? 2 : 1;
+	for (size_t n = 0; n < name_count; n++)
+	{
+		const int index = findChannelIndexViaName(component, i_name.empty() ? names[n] : i_name.c_str());
+		if (index >= 0 && Bifrost::API::Channel(component.channels()[index]).dataType() == Bifrost::API::FloatType)
+			return index;
+	}
+	return -1;
+}
+
+/*!
+ * \brief Per depth tile count, allocated and active voxels or points, fill
+ *        ratio and bytes per channel of a component
+ *
+ * The tile tree is walked once breadth first to bucket the tree indices by
+ * depth, the element counts of each depth are then reduced in parallel.
+ * Every voxel of an allocated tile is stored, so the activity of a voxel
+ * component comes from the values of one float channel, a voxel is active
+ * when its distance is negative (inside the surface) or when any other
+ * channel is not 0. The fill ratio is the active voxels over the voxels of
+ * the tiles, it is not reported without such a channel. For a point
+ * component it is the ratio of occupied tiles.
+ */
+void report_tile_occupancy(const Bifrost::API::Component& component,
+						   const std::string& i_activity_channel_name)
+{
+	Bifrost::API::Layout layout = component.layout();
+	Bifrost::API::RefArray channel_array = component.channels();
+	const size_t channel_count = channel_array.count();
+	std::vector<Bifrost::API::Channel> channels;
+	for (size_t c = 0; c < channel_count; c++)
+		channels.push_back(channel_array[c]);
+
+	const size_t depth_count = layout.depthCount();
+	std::vector< std::vector<Bifrost::API::TreeIndex> > depth_tiles(depth_count);
+	if (depth_count > 0)
+	{
+		Bifrost::API::TileIterator it = layout.tileIterator(0, depth_count - 1, Bifrost::API::BreadthFirst);
+		while (it)
+		{
+			const Bifrost::API::TileInfo info = (*it).info();
+			if (info.depth < depth_count)
+				depth_tiles[info.depth].push_back(Bifrost::API::TreeIndex(info.tile, info.depth));
+			++it;
+		}
+	}
+
+	const bool voxels = component.type() == Bifrost::API::VoxelComponentType;
+	const int activity_index = voxels ? find_activity_channel(component, i_activity_channel_name) : -1;
+	const bool inside_is_active = activity_index >= 0
+		&& std::string(channels[activity_index].name().c_str()).find("distance") != std::string::npos;
+	std::cout << boost::format("Tile occupancy of component %1% (%2%)") % component.name().c_str()
+		% (voxels ? "voxels" : "points") << std::endl;
+	if (voxels && activity_index >= 0)
+		std::cout << boost::format("\t""Active voxels : %1% %2%") % channels[activity_index].name().c_str()
+			% (inside_is_active ? "< 0" : "!= 0") << std::endl;
+	else if (voxels)
+		std::cout << "\t""Active voxels : no density or distance channel, only allocated voxels reported" << std::endl;
+	DepthOccupancy total(channel_count);
+	for (size_t d = 0; d < depth_count; d++)
+	{
+		const std::vector<Bifrost::API::TreeIndex>& tiles = depth_tiles[d];
+		DepthOccupancy occupancy = tbb::parallel_reduce(
+			tbb::blocked_range<size_t>(0, tiles.size()),
+			DepthOccupancy(channel_count),
+			[&](const tbb::blocked_range<size_t>& r, DepthOccupancy partial) -> DepthOccupancy
+			{
+				for (size_t t = r.begin(); t != r.end(); ++t)
+				{
+					size_t fullest = 0;
+					for (size_t c = 0; c < channel_count; c++)
+					{
+						const size_t count = channels[c].elementCount(tiles[t]);
+						partial.channel_elements[c] += count;
+						fullest = std::max(fullest, count);
+					}
+					partial.tiles++;
+					partial.allocated_elements += fullest;
+					if (fullest)
+						partial.occupied_tiles++;
+					if (activity_index >= 0 && channels[activity_index].elementCount(tiles[t]))
+					{
+						const Bifrost::API::TileData<float>& values = channels[activity_index].tileData<float>(tiles[t]);
+						size_t active = 0;
+						for (size_t i = 0; i < values.count(); i++)
+							active += inside_is_active ? (values[i] < 0.0f) : (values[i] != 0.0f);
+						partial.active_voxels += active;
 					}
 				}
-			}
-			++it;
+				return partial;
+			},
+			[](DepthOccupancy a, const DepthOccupancy& b) -> DepthOccupancy
+			{
+				a.merge(b);
+				return a;
+			});
+		total.merge(occupancy);
+
+		const size_t tile_size = layout.tileDimInfo(d).tileSize;
+		if (!voxels)
+		{
+			const double fill_ratio = occupancy.tiles ? double(occupancy.occupied_tiles) / occupancy.tiles : 0.0;
+			std::cout << boost::format("\t""Depth %1% : %2% tiles, %3% occupied, %4% points, fill ratio %5$.4f")
+				% d % occupancy.tiles % occupancy.occupied_tiles % occupancy.allocated_elements
+				% fill_ratio << std::endl;
+		}
+		else if (activity_index >= 0)
+		{
+			const double fill_ratio = occupancy.tiles && tile_size
+				? double(occupancy.active_voxels) / (double(occupancy.tiles) * tile_size) : 0.0;
+			std::cout << boost::format("\t""Depth %1% : %2% tiles, %3% occupied, %4% allocated voxels, %5% active voxels, fill ratio %6$.4f")
+				% d % occupancy.tiles % occupancy.occupied_tiles % occupancy.allocated_elements
+				% occupancy.active_voxels % fill_ratio << std::endl;
+		}
+		else
+		{
+			std::cout << boost::format("\t""Depth %1% : %2% tiles, %3% occupied, %4% allocated voxels")
+				% d % occupancy.tiles % occupancy.occupied_tiles % occupancy.allocated_elements << std::endl;
+		}
+		for (size_t c = 0; c < channel_count; c++)
+		{
+			const size_t element_bytes = channel_element_bytes(channels[c].dataType());
+			if (!occupancy.channel_elements[c])
+				continue;
+			if (element_bytes)
+				std::cout << boost::format("\t\t""%1% : %2% elements, %3% bytes")
+					% channels[c].name().c_str() % occupancy.channel_elements[c]
+					% (occupancy.channel_elements[c] * element_bytes) << std::endl;
+			else
+				std::cout << boost::format("\t\t""%1% : %2% elements, variable size")
+					% channels[c].name().c_str() % occupancy.channel_elements[c] << std::endl;
 		}
 	}
+
+	size_t total_bytes = 0;
+	for (size_t c = 0; c < channel_count; c++)
+		total_bytes += total.channel_elements[c] * channel_element_bytes(channels[c].dataType());
+	if (!voxels)
+		std::cout << boost::format("\t""Total : %1% tiles, %2% occupied, %3% points, %4% bytes of fixed size channel data")
+			% total.tiles % total.occupied_tiles % total.allocated_elements % total_bytes << std::endl;
+	else if (activity_index >= 0)
+		std::cout << boost::format("\t""Total : %1% tiles, %2% occupied, %3% allocated voxels, %4% active voxels, %5% bytes of fixed size channel data")
+			% total.tiles % total.occupied_tiles % total.allocated_elements % total.active_voxels % total_bytes << std::endl;
+	else
+		std::cout << boost::format("\t""Total : %1% tiles, %2% occupied, %3% allocated voxels, %4% bytes of fixed size channel data")
+			% total.tiles % total.occupied_tiles % total.allocated_elements % total_bytes << std::endl;
+}
+
+int process_bifrost_tile_occupancy(const std::string& bifrost_filename,
+								   const std::string& activity_channel_name)
+{
+	Bifrost::API::String biffile = bifrost_filename.c_str();
+	Bifrost::API::ObjectModel om;
+	Bifrost::API::FileIO fileio = om.createFileIO(biffile);
+	Bifrost::API::StateServer ss = fileio.load();
+	if (!ss.valid())
+	{
+		std::cerr << boost::format("Unable to load the content of the Bifrost file \"%1%\"") % bifrost_filename.c_str()
+				  << std::endl;
+		return 1;
+	}
+	size_t numComponents = ss.components().count();
+	for (size_t componentIndex = 0; componentIndex < numComponents; componentIndex++)
+	{
+		Bifrost::API::Component component = ss.components()[componentIndex];
+		report_tile_occupancy(component, activity_channel_name);
+	}
 	return 0;
 }
 
@@ -623,6 +813,7 @@ int main(int argc, char **argv)
 		BBOX bbox_type = BBOX::None;
 		std::string bifrost_filename;
 		float fps = 24.0f;
+		std::string activity_channel_name;
 		po::options_description desc("Allowed options");
 		desc.add_options()
 			("version", "print version string")
@@ -630,6 +821,9 @@ int main(int argc, char **argv)
 			("bbox", po::value<BBOX>(&bbox_type), "Analyze the entire file to obtain the overall bounding box [0:None, 1:PointsOnly, 2:PointsWithVelocity]")
 			("fps", po::value<float>(&fps),
 				"Frames per second to scale velocity when determining the velocity-attenuated bounding box. Defaults to 24.0")
+			("occupancy", "Report per depth tile count, allocated and active voxels or points, fill ratio and bytes per channel")
+			("activity-channel", po::value<std::string>(&activity_channel_name),
+				"Float channel deciding the active voxels of --occupancy, negative distance or non zero values. Defaults to density, else distance")
 				("input-file", po::value<std::vector<std::string> >(),
 					"input files")
 			;
@@ -662,6 +856,8 @@ int main(int argc, char **argv)
 		std::cout << "fps = " << fps << std::endl;
 		if (bifrost_filename.size() > 0)
 		{
+			if (vm.count("occupancy"))
+				return process_bifrost_tile_occupancy(bifrost_filename, activity_channel_name);
 			process_bifrost_voxel(bifrost_filename);
 			/*
 			process_bifrost_file(bifrost_filename,
@@ -0,0 +1,187 @@
+#include "FrameRingBuffer.h"
+#include <utils/BifrostUtils.h>
+#include <boost/format.hpp>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <iostream>
+
+#include <BifrostHeaders.h>
+
+namespace {
+
+double seconds_since(const std::chrono::steady_clock::time_point& i_start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - i_start).count();
+}
+
+} // namespace
+
+bool decode_play_frame(const std::string& i_filename, PlayFrame& o_frame)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    o_frame.filename = i_filename;
+    o_frame.positions.clear();
+    o_frame.valid = false;
+
+    Bifrost::API::String biffile = i_filename.c_str();
+    Bifrost::API::ObjectModel om;
+    Bifrost::API::FileIO fileio = om.createFileIO( biffile );
+    o_frame.openSeconds = seconds_since(start);
+    Bifrost::API::StateServer ss = fileio.load( );
+    o_frame.loadSeconds = seconds_since(start) - o_frame.openSeconds;
+    if ( !ss.valid() ) {
+        std::cerr << boost::format("bifplay : unable to load the content of the Bifrost file \"%1%\"") % i_filename << std::endl;
+        o_frame.decodeSeconds = seconds_since(start);
+        return false;
+    }
+
+    float bmin[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float bmax[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+    size_t numComponents = ss.components().count();
+    for (size_t componentIndex=0;componentIndex<numComponents;componentIndex++)
+    {
+        Bifrost::API::Component component = ss.components()[componentIndex];
+        if ( component.type() != Bifrost::API::PointComponentType )
+            continue;
+        int positionChannelIndex = findChannelIndexViaName(component,"position");
+        if (positionChannelIndex<0)
+            continue;
+        Bifrost::API::Channel position_ch = component.channels()[positionChannelIndex];
+        if (position_ch.dataType() != Bifrost::API::FloatV3Type)
+            continue;
+
+        Bifrost::API::Layout layout = component.layout();
+        const float voxel_scale = layout.voxelScale();
+        o_frame.positions.reserve(o_frame.positions.size() + 3 * component.elementCount());
+        size_t depthCount = layout.depthCount();
+        for ( size_t d=0; d<depthCount; d++ ) {
+            size_t tcount = layout.tileCount(d);
+            for ( size_t t=0; t<tcount; t++ ) {
+                Bifrost::API::TreeIndex tindex(t,d);
+                if ( !position_ch.elementCount( tindex ) ) {
+                    // nothing there
+                    continue;
+                }
+                const Bifrost::API::TileData<amino::Math::vec3f>& position_tile_data = position_ch.tileData<amino::Math::vec3f>( tindex );
+                for (size_t i=0; i<position_tile_data.count(); i++ ) {
+                    for (int c=0;c<3;c++)
+                    {
+                        const float value = position_tile_data[i][c] * voxel_scale;
+                        o_frame.positions.push_back(value);
+                        bmin[c] = std::min(bmin[c],value);
+                        bmax[c] = std::max(bmax[c],value);
+                    }
+                }
+            }
+        }
+    }
+    if (!o_frame.positions.empty())
+    {
+        std::copy(bmin,bmin+3,o_frame.bounds);
+        std::copy(bmax,bmax+3,o_frame.bounds+3);
+    }
+    o_frame.valid = true;
+    o_frame.decodeSeconds = seconds_since(start);
+    o_frame.gatherSeconds = o_frame.decodeSeconds - o_frame.openSeconds - o_frame.loadSeconds;
+    return true;
+}
+
+FrameRingBuffer::FrameRingBuffer(const StringContainer& i_filenames,
+                                 size_t i_capacity,
+                                 size_t i_decoderCount)
+: _filenames(i_filenames)
+, _slots(std::max<size_t>(i_capacity,1))
+, _readPosition(0)
+, _writePosition(0)
+, _stop(_filenames.empty())
+{
+    // More decoders than slots would only wait on the ring
+    const size_t decoderCount = std::max<size_t>(1,std::min(i_decoderCount,_slots.size()));
+    for (size_t i=0;i<decoderCount;i++)
+        _decoders.push_back(std::thread(&FrameRingBuffer::decode_loop, this));
+}
+
+FrameRingBuffer::~FrameRingBuffer()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _writable.notify_all();
+    _readable.notify_all();
+    for (size_t i=0;i<_decoders.size();i++)
+        if (_decoders[i].joinable())
+            _decoders[i].join();
+}
+
+PlayFrameConstPtr FrameRingBuffer::next(bool i_wait)
+{
+    PlayFrameConstPtr frame;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        Slot& slot = _slots[_readPosition % _slots.size()];
+        if (i_wait)
+        {
+            while (!_stop && !(slot.ready && slot.position == _readPosition))
+                _readable.wait(lock);
+        }
+        if (!(slot.ready && slot.position == _readPosition))
+            return PlayFrameConstPtr();
+        frame.swap(slot.frame);
+        slot.ready = false;
+        _readPosition++;
+    }
+    _writable.notify_one();
+    return frame;
+}
+
+PlayFrameConstPtr FrameRingBuffer::next(const std::chrono::steady_clock::duration& i_timeout)
+{
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + i_timeout;
+    PlayFrameConstPtr frame;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        Slot& slot = _slots[_readPosition % _slots.size()];
+        while (!_stop && !(slot.ready && slot.position == _readPosition))
+        {
+            if (_readable.wait_until(lock, deadline) == std::cv_status::timeout)
+                break;
+        }
+        if (!(slot.ready && slot.position == _readPosition))
+            return PlayFrameConstPtr();
+        frame.swap(slot.frame);
+        slot.ready = false;
+        _readPosition++;
+    }
+    _writable.notify_one();
+    return frame;
+}
+
+void FrameRingBuffer::decode_loop()
+{
+    while (true)
+    {
+        size_t position = 0;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (!_stop && _writePosition >= _readPosition + _slots.size())
+                _writable.wait(lock);
+            if (_stop)
+                return;
+            position = _writePosition++;
+        }
+
+        std::shared_ptr<PlayFrame> frame(new PlayFrame);
+        decode_play_frame(_filenames[position % _filenames.size()], *frame);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Slot& slot = _slots[position % _slots.size()];
+            slot.position = position;
+            slot.frame = frame;
+            slot.ready = true;
+        }
+        _readable.notify_all();
+    }
+}
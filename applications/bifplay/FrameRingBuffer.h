@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief Point positions of one Bifrost file, ready for upload to a VBO
+ */
+struct PlayFrame
+{
+    PlayFrame() : openSeconds(0.0), loadSeconds(0.0), gatherSeconds(0.0), decodeSeconds(0.0), valid(false)
+    {
+        bounds[0] = bounds[1] = bounds[2] = 0.0f;
+        bounds[3] = bounds[4] = bounds[5] = 0.0f;
+    }
+    std::string filename;
+    std::vector<float> positions; //!< xyz in world space
+    float bounds[6]; //!< min xyz then max xyz, valid when positions is not empty
+    double openSeconds; //!< object model and file setup
+    double loadSeconds; //!< Bifrost file read
+    double gatherSeconds; //!< position channel gathered into positions
+    double decodeSeconds; //!< open, load and gather
+    bool valid;
+};
+typedef std::shared_ptr<const PlayFrame> PlayFrameConstPtr;
+
+/*!
+ * \brief Read the point components of a Bifrost file
+ * \return false if the file could not be read, o_frame is then not valid
+ */
+bool decode_play_frame(const std::string& i_filename, PlayFrame& o_frame);
+
+/*!
+ * \brief Fixed size ring of decoded frames of a looping sequence
+ *
+ * Decoder threads fill the slots ahead of the play position, at most
+ * capacity frames ahead, and block while the ring is full. The player takes
+ * the frames in order with next(), which frees their slot for the decoders.
+ */
+class FrameRingBuffer
+{
+public:
+    typedef std::vector<std::string> StringContainer;
+
+    FrameRingBuffer(const StringContainer& i_filenames,
+                    size_t i_capacity,
+                    size_t i_decoderCount);
+    ~FrameRingBuffer();
+
+    /*!
+     * \brief Frame at the play position, the position then advances and
+     *        wraps at the end of the sequence
+     * \param i_wait block until the frame is decoded, otherwise return null
+     *        when it is not yet available
+     */
+    PlayFrameConstPtr next(bool i_wait);
+    /*!
+     * \brief Same as above, waiting at most i_timeout for the frame
+     */
+    PlayFrameConstPtr next(const std::chrono::steady_clock::duration& i_timeout);
+
+    size_t capacity() const { return _slots.size(); }
+    size_t decoderCount() const { return _decoders.size(); }
+private:
+    struct Slot
+    {
+        Slot() : position(0), ready(false) {}
+        size_t position; //!< sequence position held, frame index is position modulo sequence length
+        bool ready;
+        PlayFrameConstPtr frame;
+    };
+
+    void decode_loop();
+
+    StringContainer _filenames;
+    std::vector<Slot> _slots;
+    std::vector<std::thread> _decoders;
+    std::mutex _mutex;
+    std::condition_variable _readable;
+    std::condition_variable _writable;
+    size_t _readPosition; //!< next position given by next()
+    size_t _writePosition; //!< next position handed to a decoder
+    bool _stop;
+};
+
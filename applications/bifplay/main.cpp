@@ -2,8 +2,19 @@
 #include <GLFW/glfw3.h>
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "FrameRingBuffer.h"
+
+namespace po = boost::program_options;
 
 GLFWwindow* g_window;
 
@@ -178,16 +189,150 @@ keyboard(GLFWwindow* window, int key, int scancode, int action, int mods)
 		g_running = 0;
         glfwSetWindowShouldClose(window, GL_TRUE);
 	}
+    else if (key == GLFW_KEY_SPACE && action == GLFW_PRESS)
+    {
+        g_freeze = !g_freeze;
+    }
 }
 
-/* static */ void idle()
+/*!
+ * \brief GL objects drawing the points of the current frame
+ */
+struct PointDrawable
 {
+    PointDrawable() : program(0), vao(0), vbo(0), pointCount(0), mvpLocation(-1), pointSizeLocation(-1), colorLocation(-1) {}
+    GLuint program;
+    GLuint vao;
+    GLuint vbo;
+    GLsizei pointCount;
+    GLint mvpLocation;
+    GLint pointSizeLocation;
+    GLint colorLocation;
+} g_points;
+
+float g_pointSize = 2.0f;
+
+// GLSL 3.30 core, available with Mesa's llvmpipe software rasterizer
+/*! \brief Longest wait for a late frame before the window is serviced again */
+static const std::chrono::milliseconds STALL_WAIT(5);
+/*! \brief Longest sleep while no frame is due, bounds the report latency */
+static const double IDLE_WAIT_SECONDS = 0.1;
+
+static const char* POINT_VERTEX_SHADER =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 position;\n"
+    "uniform mat4 ModelViewProjectionMatrix;\n"
+    "uniform float pointSize;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = ModelViewProjectionMatrix * vec4(position, 1.0);\n"
+    "    gl_PointSize = pointSize;\n"
+    "}\n";
+static const char* POINT_FRAGMENT_SHADER =
+    "#version 330 core\n"
+    "uniform vec4 pointColor;\n"
+    "out vec4 fragColor;\n"
+    "void main()\n"
+    "{\n"
+    "    fragColor = pointColor;\n"
+    "}\n";
+
+GLuint compile_shader(GLenum type, const char* source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[4096];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        std::cerr << boost::format("bifplay : shader compilation failed : %1%") % log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
 }
 
-/* static */ void display()
+bool setup_points()
 {
+    GLuint vertexShader = compile_shader(GL_VERTEX_SHADER, POINT_VERTEX_SHADER);
+    GLuint fragmentShader = compile_shader(GL_FRAGMENT_SHADER, POINT_FRAGMENT_SHADER);
+    if (!vertexShader || !fragmentShader)
+        return false;
+    g_points.program = glCreateProgram();
+    glAttachShader(g_points.program, vertexShader);
+    glAttachShader(g_points.program, fragmentShader);
+    glLinkProgram(g_points.program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    GLint status = GL_FALSE;
+    glGetProgramiv(g_points.program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[4096];
+        glGetProgramInfoLog(g_points.program, sizeof(log), NULL, log);
+        std::cerr << boost::format("bifplay : shader link failed : %1%") % log << std::endl;
+        return false;
+    }
+    g_points.mvpLocation = glGetUniformLocation(g_points.program, "ModelViewProjectionMatrix");
+    g_points.pointSizeLocation = glGetUniformLocation(g_points.program, "pointSize");
+    g_points.colorLocation = glGetUniformLocation(g_points.program, "pointColor");
+
+    glGenVertexArrays(1, &g_points.vao);
+    glGenBuffers(1, &g_points.vbo);
+    glBindVertexArray(g_points.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, g_points.vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindVertexArray(0);
+
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+    return true;
+}
 
+/*!
+ * \brief Upload the frame positions, done once per frame, the redraws
+ *        while the frame stays current reuse the buffer
+ */
+void upload_points(const PlayFrame& frame)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, g_points.vbo);
+    // Orphan the previous storage so the upload does not wait on pending draws
+    glBufferData(GL_ARRAY_BUFFER, frame.positions.size() * sizeof(float), NULL, GL_STREAM_DRAW);
+    if (!frame.positions.empty())
+        glBufferSubData(GL_ARRAY_BUFFER, 0, frame.positions.size() * sizeof(float), &frame.positions[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    g_points.pointCount = static_cast<GLsizei>(frame.positions.size() / 3);
+}
 
+/*!
+ * \brief Frame the camera on the bounds of the first frame
+ */
+void frame_camera(const PlayFrame& frame)
+{
+    if (frame.positions.empty())
+        return;
+    float diagonal = 0.0f;
+    for (int c=0;c<3;c++)
+    {
+        g_center[c] = 0.5f * (frame.bounds[c] + frame.bounds[c+3]);
+        const float extent = frame.bounds[c+3] - frame.bounds[c];
+        diagonal += extent * extent;
+    }
+    g_size = sqrtf(diagonal);
+    g_dolly = std::max(g_size * 1.5f, 0.01f);
+}
+
+/* static */ void idle()
+{
+}
+
+/* static */ void display()
+{
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glViewport(0, 0, g_width, g_height);
@@ -197,68 +342,227 @@ keyboard(GLFWwindow* window, int key, int scancode, int action, int mods)
     translate(g_transformData.ModelViewMatrix, -g_pan[0], -g_pan[1], -g_dolly);
     rotate(g_transformData.ModelViewMatrix, g_rotate[1], 1, 0, 0);
     rotate(g_transformData.ModelViewMatrix, g_rotate[0], 0, 1, 0);
-    rotate(g_transformData.ModelViewMatrix, -90, 1, 0, 0);
     translate(g_transformData.ModelViewMatrix,
               -g_center[0], -g_center[1], -g_center[2]);
     perspective(g_transformData.ProjectionMatrix,
-                45.0f, (float)aspect, 0.01f, 500.0f);
+                45.0f, (float)aspect, std::max(g_size * 0.001f, 0.01f), std::max(g_size * 10.0f, 500.0f));
     multMatrix(g_transformData.ModelViewProjectionMatrix,
                g_transformData.ModelViewMatrix,
                g_transformData.ProjectionMatrix);
-    glFinish();
-
-    glPushMatrix();
-    glMultMatrixf(g_transformData.ModelViewProjectionMatrix);
-
-// #define DRAW_TRIANGLE
-#ifdef DRAW_TRIANGLE
-    glBegin(GL_TRIANGLES);
-    glColor3f(1.f, 0.f, 0.f);
-    glVertex3f(-0.6f, -0.4f, 0.f);
-    glColor3f(0.f, 1.f, 0.f);
-    glVertex3f(0.6f, -0.4f, 0.f);
-    glColor3f(0.f, 0.f, 1.f);
-    glVertex3f(-0.6f, 0.6f, 0.f);
-    glEnd();
-#else // DRAW_TRIANGLE
-    glBegin(GL_QUADS);
-    glColor3f(1.f, 0.f, 0.f);
-    glVertex3f(-0.6f, -0.4f, 0.f);
-    glColor3f(0.f, 1.f, 0.f);
-    glVertex3f(0.6f, -0.4f, 0.f);
-    glColor3f(0.f, 0.f, 1.f);
-    glVertex3f(0.6f, 0.6f, 0.f);
-    glColor3f(1.f, 1.f, 1.f);
-    glVertex3f(-0.6f, 0.6f, 0.f);
-    glEnd();
-#endif // DRAW_TRIANGLE
-
-    // g_ogl2.draw_ogl(OpenGL2Translator::DRAW_AS_WIREFRAME);
-
-    glPopMatrix();
-    glFinish();
 
+    if (!g_points.pointCount)
+        return;
+    const float color[4] = {0.4f, 0.7f, 1.0f, 1.0f};
+    glUseProgram(g_points.program);
+    glUniformMatrix4fv(g_points.mvpLocation, 1, GL_FALSE, g_transformData.ModelViewProjectionMatrix);
+    glUniform1f(g_points.pointSizeLocation, g_pointSize);
+    glUniform4fv(g_points.colorLocation, 1, color);
+    glBindVertexArray(g_points.vao);
+    glDrawArrays(GL_POINTS, 0, g_points.pointCount);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+/*!
+ * \brief Playback counters since the last report
+ */
+struct PlaybackStats
+{
+    PlaybackStats() { reset(); }
+    void reset()
+    {
+        playedFrames = 0;
+        stalls = 0;
+        decodeSeconds = 0.0;
+        loadSeconds = 0.0;
+        uploadSeconds = 0.0;
+    }
+    void add(const PlaybackStats& other)
+    {
+        playedFrames += other.playedFrames;
+        stalls += other.stalls;
+        decodeSeconds += other.decodeSeconds;
+        loadSeconds += other.loadSeconds;
+        uploadSeconds += other.uploadSeconds;
+    }
+    size_t playedFrames;
+    size_t stalls; //!< frame due but not decoded yet
+    double decodeSeconds;
+    double loadSeconds;
+    double uploadSeconds;
+};
+
+void report(const PlaybackStats& stats, double elapsed, double targetFps, size_t decoderCount)
+{
+    if (!stats.playedFrames || elapsed <= 0.0)
+        return;
+    const double decodeMs = 1000.0 * stats.decodeSeconds / stats.playedFrames;
+    const double loadMs = 1000.0 * stats.loadSeconds / stats.playedFrames;
+    const double uploadMs = 1000.0 * stats.uploadSeconds / stats.playedFrames;
+    const double sustainableFps = decodeMs > 0.0 ? 1000.0 * decoderCount / decodeMs : 0.0;
+    std::cout << boost::format("bifplay : %1$.1f fps played (target %2%), decode %3$.1f ms/frame (file read %4$.1f ms) on %5% decoders, %6$.1f fps sustainable, upload %7$.2f ms/frame, %8% stalls")
+        % (stats.playedFrames / elapsed)
+        % (targetFps > 0.0 ? (boost::format("%1$.1f") % targetFps).str() : std::string("unlimited"))
+        % decodeMs
+        % loadMs
+        % decoderCount
+        % sustainableFps
+        % uploadMs
+        % stats.stalls
+              << std::endl;
+}
+
+/*!
+ * \brief Peak resident set size of the process in megabytes, negative
+ *        when the platform does not report it
+ */
+double peak_rss_megabytes()
+{
+#ifdef _WIN32
+    return -1.0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1.0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0; // kilobytes
+#endif
+#endif
+}
+
+/*!
+ * \brief Decode frame_count frames through the playback ring buffer as fast
+ *        as possible, without a window, and report the per stage timings
+ *
+ * The upload preparation stage is the copy of the positions into a staging
+ * buffer, the CPU side of the VBO upload done by the interactive player.
+ */
+int run_bench(const std::vector<std::string>& bif_files,
+              size_t frame_count,
+              size_t buffer_frames,
+              size_t decoder_count,
+              double target_fps)
+{
+    typedef std::chrono::steady_clock Clock;
+    double openSeconds = 0.0;
+    double loadSeconds = 0.0;
+    double gatherSeconds = 0.0;
+    double decodeSeconds = 0.0;
+    double maxDecodeSeconds = 0.0;
+    double prepSeconds = 0.0;
+    size_t pointCount = 0;
+    size_t failures = 0;
+    size_t decoded = 0;
+    std::vector<float> staging;
+
+    const Clock::time_point start = Clock::now();
+    size_t decoders = 0;
+    double elapsed = 0.0;
+    {
+        FrameRingBuffer ring(bif_files, buffer_frames, decoder_count);
+        decoders = ring.decoderCount();
+        for (; decoded<frame_count; decoded++)
+        {
+            PlayFrameConstPtr frame = ring.next(true);
+            if (!frame)
+                break;
+            if (!frame->valid)
+                failures++;
+            const Clock::time_point prepStart = Clock::now();
+            staging.assign(frame->positions.begin(), frame->positions.end());
+            prepSeconds += std::chrono::duration<double>(Clock::now() - prepStart).count();
+            openSeconds += frame->openSeconds;
+            loadSeconds += frame->loadSeconds;
+            gatherSeconds += frame->gatherSeconds;
+            decodeSeconds += frame->decodeSeconds;
+            maxDecodeSeconds = std::max(maxDecodeSeconds, frame->decodeSeconds);
+            pointCount += frame->positions.size() / 3;
+        }
+        // Taken before the ring goes out of scope, joining the decoders is not playback
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    if (!decoded || elapsed <= 0.0)
+    {
+        std::cerr << "bifplay : no frame decoded" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const double toMs = 1000.0 / decoded;
+    const double sustainedFps = decoded / elapsed;
+    std::cout << boost::format("bifplay bench : %1% frames of %2% files, %3% decoders, %4% buffered frames")
+        % decoded % bif_files.size() % decoders % buffer_frames << std::endl;
+    std::cout << boost::format("  open        %1$10.2f ms/frame") % (openSeconds * toMs) << std::endl;
+    std::cout << boost::format("  load        %1$10.2f ms/frame") % (loadSeconds * toMs) << std::endl;
+    std::cout << boost::format("  gather      %1$10.2f ms/frame") % (gatherSeconds * toMs) << std::endl;
+    std::cout << boost::format("  upload-prep %1$10.2f ms/frame") % (prepSeconds * toMs) << std::endl;
+    std::cout << boost::format("  decode      %1$10.2f ms/frame (max %2$.2f ms)") % (decodeSeconds * toMs) % (1000.0 * maxDecodeSeconds) << std::endl;
+    std::cout << boost::format("  points      %1$10.0f per frame") % (static_cast<double>(pointCount) / decoded) << std::endl;
+    std::cout << boost::format("  sustained   %1$10.2f fps (%2$.2f Mpoints/s)") % sustainedFps % (pointCount / elapsed / 1.0e6) << std::endl;
+    const double peakRss = peak_rss_megabytes();
+    if (peakRss >= 0.0)
+        std::cout << boost::format("  peak RSS    %1$10.1f MB") % peakRss << std::endl;
+    if (target_fps > 0.0)
+        std::cout << boost::format("  real time at %1% fps : %2%") % target_fps % (sustainedFps >= target_fps ? "yes" : "no") << std::endl;
+    if (failures)
+        std::cerr << boost::format("bifplay : %1% frames failed to decode") % failures << std::endl;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
 int main(int argc, char **argv)
 {
-	if (argc!=2)
-	{
-		std::cerr << boost::format("Usage : %1% <bifrost-file>") % argv[0] << std::endl;
+    std::vector<std::string> bif_files;
+    double target_fps = 24.0;
+    size_t decoder_count = std::max<size_t>(1, std::thread::hardware_concurrency() / 2);
+    size_t buffer_frames = 8;
+    double report_interval = 2.0;
+    bool bench = false;
+    size_t bench_frames = 0;
+    try {
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            ("help", "produce help message")
+            ("bif", po::value< std::vector<std::string> >(&bif_files), "bifrost files of the sequence, played in name order")
+            ("fps", po::value<double>(&target_fps), "playback rate, 0 plays as fast as the frames are decoded")
+            ("decoders", po::value<size_t>(&decoder_count), "number of background decoder threads")
+            ("buffer", po::value<size_t>(&buffer_frames), "number of decoded frames kept ahead of the play position")
+            ("point-size", po::value<float>(&g_pointSize), "point size in pixels")
+            ("report", po::value<double>(&report_interval), "seconds between playback reports, 0 only reports on exit")
+            ("bench", "decode the sequence through the playback pipeline without a window and report timings")
+            ("frames", po::value<size_t>(&bench_frames), "number of frames decoded by --bench, the sequence length by default")
+            ;
+        po::positional_options_description positional;
+        positional.add("bif", -1);
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+        po::notify(vm);
+        if (vm.count("help") || bif_files.empty()) {
+            std::cerr << boost::format("Usage : %1% [options] <bifrost-file> ...") % argv[0] << std::endl;
+            std::cerr << desc << std::endl;
+            std::cerr << "Runs with Mesa's software OpenGL (e.g. LIBGL_ALWAYS_SOFTWARE=1 under Xvfb) on nodes without a GPU" << std::endl;
+            exit(vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        bench = vm.count("bench") > 0;
+    }
+    catch(std::exception& e) {
+        std::cerr << boost::format("bifplay : %1%") % e.what() << std::endl;
         exit(EXIT_FAILURE);
-	}
-	std::string bgeo_file(argv[1]);
+    }
+    std::sort(bif_files.begin(), bif_files.end());
+
+    if (bench)
+        return run_bench(bif_files, bench_frames ? bench_frames : bif_files.size(), buffer_frames, decoder_count, target_fps);
+
     // glfwSetErrorCallback(error_callback);
     if (!glfwInit())
         exit(EXIT_FAILURE);
 
-// #if defined(__APPLE__) || defined (_WIN32)
-//#if defined(__APPLE__)
-//    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-//    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-//    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-//    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-//#endif // defined(__APPLE__) || defined (_WIN32)
+    // Core profile, the drawing only relies on VAO/VBO and GLSL 3.30
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     std::string windows_title = (boost::format("Bifrost Viewer")).str();
     g_window = glfwCreateWindow(640, 480, windows_title.c_str(), NULL, NULL);
@@ -268,15 +572,6 @@ int main(int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
-    // Setup the geometry extractor
-//    g_ge.initialize(bgeo_file);
-//    g_ogl2.initialize(g_ge.getHeader(),
-//    		g_ge.getInfo(),
-//			g_ge.getTopology(),
-//			g_ge.getAttributes(),
-//			g_ge.getPrimitives(),
-//			g_ge.getAttributeTypeMap());
-    // g_ogl2.dump();
     glfwMakeContextCurrent(g_window);
 
     glfwGetFramebufferSize(g_window, &g_width, &g_height);
@@ -289,26 +584,101 @@ int main(int argc, char **argv)
 
     // MUST do this AFTER a GL context i.e. glfw context is available
     // MUST call glewInit() BEFORE any calls to additional API e.g. OpenGL 3.3 calls, are made
+    // Core profiles need the experimental flag for GLEW to load the entry points
+    glewExperimental = GL_TRUE;
     GLenum err = glewInit();
     if (GLEW_OK != err)
     {
         /* Problem: glewInit failed, something is seriously wrong. */
         fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+    // glewInit may leave a GL_INVALID_ENUM behind on core profiles
+    glGetError();
 
+    std::cout << boost::format("Bifrost Viewer : OpenGL version supported by this platform (%1%): ") % glGetString(GL_VERSION) << std::endl;
+    if (!setup_points())
+    {
+        glfwTerminate();
+        exit(EXIT_FAILURE);
     }
 
-    // g_ogl2.setup_ogl();
-    std::cout << boost::format("HouGeo Viewer : OpenGL version supported by this platform (%1%): ") % glGetString(GL_VERSION) << std::endl;
+    FrameRingBuffer ring(bif_files, buffer_frames, decoder_count);
+
+    typedef std::chrono::steady_clock Clock;
+    PlaybackStats stats;
+    PlaybackStats totalStats;
+    const Clock::time_point start = Clock::now();
+    Clock::time_point reportStart = start;
+    Clock::time_point nextFrameTime = start;
+    const Clock::duration framePeriod = target_fps > 0.0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / target_fps))
+        : Clock::duration::zero();
+    bool firstFrame = true;
+    bool stalled = false; //!< the due frame was already counted as a stall
 
     glfwSwapInterval(0);
-    while (g_running)
+    while (g_running && !glfwWindowShouldClose(g_window))
     {
         idle();
+        const Clock::time_point now = Clock::now();
+        if (!g_freeze && now >= nextFrameTime)
+        {
+            // The first frame is waited for, afterwards a late frame is waited
+            // for briefly and the previous one stays on screen meanwhile
+            PlayFrameConstPtr frame = firstFrame ? ring.next(true) : ring.next(STALL_WAIT);
+            if (frame)
+            {
+                const Clock::time_point uploadStart = Clock::now();
+                upload_points(*frame);
+                const double uploadSeconds = std::chrono::duration<double>(Clock::now() - uploadStart).count();
+                if (firstFrame)
+                    frame_camera(*frame);
+                firstFrame = false;
+                stats.playedFrames++;
+                stats.decodeSeconds += frame->decodeSeconds;
+                stats.loadSeconds += frame->loadSeconds;
+                stats.uploadSeconds += uploadSeconds;
+                nextFrameTime = std::max(nextFrameTime + framePeriod, now - framePeriod);
+                stalled = false;
+            }
+            else if (!stalled)
+            {
+                stats.stalls++;
+                stalled = true;
+            }
+        }
         display();
-        glfwPollEvents();
         glfwSwapBuffers(g_window);
+
+        // Sleep until the next frame is due or an input event arrives, a
+        // stalled frame already waited in the ring buffer
+        double waitSeconds = IDLE_WAIT_SECONDS;
+        if (!g_freeze && !stalled)
+            waitSeconds = std::min(waitSeconds, std::chrono::duration<double>(nextFrameTime - Clock::now()).count());
+        if (waitSeconds > 0.0)
+            glfwWaitEventsTimeout(waitSeconds);
+        else
+            glfwPollEvents();
+
+        const double reportElapsed = std::chrono::duration<double>(Clock::now() - reportStart).count();
+        if (report_interval > 0.0 && reportElapsed >= report_interval)
+        {
+            report(stats, reportElapsed, target_fps, ring.decoderCount());
+            totalStats.add(stats);
+            stats.reset();
+            reportStart = Clock::now();
+        }
     }
+    totalStats.add(stats);
+    report(totalStats, std::chrono::duration<double>(Clock::now() - start).count(), target_fps, ring.decoderCount());
+
+    glDeleteBuffers(1, &g_points.vbo);
+    glDeleteVertexArrays(1, &g_points.vao);
+    glDeleteProgram(g_points.program);
     glfwDestroyWindow(g_window);
     glfwTerminate();
-    exit(EXIT_SUCCESS);
+    // Return rather than exit() so the decoder threads are joined
+    return EXIT_SUCCESS;
 }
@@ -0,0 +1,399 @@
+#include <utils/BifrostUtils.h>
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <stdint.h>
+
+#include <BifrostHeaders.h>
+
+namespace po = boost::program_options;
+
+typedef std::vector<std::string> StringContainer;
+
+/*!
+ * \brief Shape of the synthetic Bifrost files, identical options and seed
+ *        always produce identical files
+ */
+struct SynthOptions
+{
+	SynthOptions()
+		: voxels(false)
+		, point_count(1000000)
+		, tile_grid(8)
+		, sparsity(0.0f)
+		, voxel_scale(0.1f)
+		, frames(1)
+		, fps(24.0f)
+		, seed(1)
+	{}
+	bool voxels; //!< write a voxel component instead of a point component
+	size_t point_count;
+	size_t tile_grid; //!< tiles per side of the cube of candidate tiles
+	float sparsity; //!< fraction of the candidate tiles left empty
+	float voxel_scale;
+	size_t frames;
+	float fps;
+	unsigned seed;
+	StringContainer channels; //!< channels in addition to position for points
+	std::string output; //!< file name, a printf pattern receiving the frame when frames > 1
+};
+
+/*!
+ * \brief Velocity of a swirl around the Y axis of the tile cube, in voxels
+ *        per second, smooth so that the data compresses like a simulation
+ */
+inline amino::Math::vec3f swirl_velocity(const amino::Math::vec3f& p, float center)
+{
+	amino::Math::vec3f v;
+	v.v[0] = -(p.v[2] - center);
+	v.v[1] = 0.25f * sinf(p.v[0] * 0.05f) * center;
+	v.v[2] = p.v[0] - center;
+	return v;
+}
+
+/*!
+ * \brief Curl of swirl_velocity, the vorticity channel of the fixtures
+ */
+inline amino::Math::vec3f swirl_vorticity(const amino::Math::vec3f& p, float center)
+{
+	amino::Math::vec3f w;
+	w.v[0] = 0.0f;
+	w.v[1] = -2.0f;
+	w.v[2] = 0.0125f * cosf(p.v[0] * 0.05f) * center;
+	return w;
+}
+
+inline float density_field(const amino::Math::vec3f& p, float center)
+{
+	const float x = (p.v[0] - center) / center;
+	const float y = (p.v[1] - center) / center;
+	const float z = (p.v[2] - center) / center;
+	return std::max(0.0f, 1.0f - sqrtf(x*x + y*y + z*z)) * (0.75f + 0.25f * sinf(p.v[1] * 0.2f));
+}
+
+/*!
+ * \brief Vector channels are FloatV3Type, id64 is UInt64Type and any other
+ *        channel name FloatType
+ */
+Bifrost::API::DataType synth_channel_type(const std::string& channel_name)
+{
+	if (channel_name == "velocity" || channel_name == "vorticity")
+		return Bifrost::API::FloatV3Type;
+	if (channel_name == "id64")
+		return Bifrost::API::UInt64Type;
+	return Bifrost::API::FloatType;
+}
+
+/*!
+ * \brief Voxel space corner of the candidate tiles kept after the sparsity
+ *        is applied, the same tiles for every frame
+ */
+void select_occupied_tiles(const SynthOptions& options,
+						   float tile_voxel_width,
+						   std::vector<amino::Math::vec3f>& o_corners)
+{
+	std::mt19937 generator(options.seed);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	o_corners.clear();
+	for (size_t k = 0; k < options.tile_grid; k++)
+		for (size_t j = 0; j < options.tile_grid; j++)
+			for (size_t i = 0; i < options.tile_grid; i++)
+			{
+				if (uniform(generator) < options.sparsity)
+					continue;
+				amino::Math::vec3f corner;
+				corner.v[0] = i * tile_voxel_width;
+				corner.v[1] = j * tile_voxel_width;
+				corner.v[2] = k * tile_voxel_width;
+				o_corners.push_back(corner);
+			}
+}
+
+template<typename T>
+bool write_synth_channel(Bifrost::API::StateServer& ss,
+						 Bifrost::API::Component& component,
+						 Bifrost::API::DataType data_type,
+						 const std::string& channel_name,
+						 const std::vector<T>& values,
+						 const std::vector<size_t>& order,
+						 const PointTileRangeContainer& tiles)
+{
+	Bifrost::API::Channel channel = ss.createChannel(component, data_type, channel_name.c_str());
+	if (!channel.valid())
+	{
+		std::cerr << boost::format("bifsynth : unable to create channel '%1%'") % channel_name << std::endl;
+		return false;
+	}
+	return set_point_channel_data<T>(channel, values, order, tiles);
+}
+
+/*!
+ * \brief Points spread uniformly over the occupied tiles, advected along
+ *        the swirl by the frame time
+ */
+bool synth_points(const SynthOptions& options, size_t frame, const std::string& filename)
+{
+	Bifrost::API::ObjectModel om;
+	Bifrost::API::StateServer ss = om.createStateServer();
+	Bifrost::API::Layout layout = ss.createLayout("bifsynth_layout", options.voxel_scale);
+	Bifrost::API::Component component = ss.createComponent(Bifrost::API::PointComponentType,
+														   "bifsynth-particle",
+														   layout);
+	if (!component.valid())
+	{
+		std::cerr << "bifsynth : unable to create the Bifrost point component" << std::endl;
+		return false;
+	}
+
+	Bifrost::API::TileDimInfo tile_dim_info = layout.tileDimInfo(layout.maxDepth());
+	const float tile_voxel_width = tile_dim_info.tileWidth * tile_dim_info.voxelWidth;
+	std::vector<amino::Math::vec3f> corners;
+	select_occupied_tiles(options, tile_voxel_width, corners);
+	if (corners.empty() || !options.point_count)
+	{
+		std::cerr << "bifsynth : no point to write, lower the sparsity or raise the point count" << std::endl;
+		return false;
+	}
+
+	const float center = 0.5f * options.tile_grid * tile_voxel_width;
+	const float time = frame / options.fps;
+	std::mt19937 generator(options.seed + 1);
+	std::uniform_real_distribution<float> uniform(0.0f, tile_voxel_width);
+	std::vector<amino::Math::vec3f> voxel_positions(options.point_count);
+	std::vector<amino::Math::vec3f> velocities(options.point_count);
+	const bool with_vorticity = std::find(options.channels.begin(), options.channels.end(), "vorticity") != options.channels.end();
+	std::vector<amino::Math::vec3f> vorticities(with_vorticity ? options.point_count : 0);
+	for (size_t i = 0; i < options.point_count; i++)
+	{
+		amino::Math::vec3f p = corners[i % corners.size()];
+		for (int c = 0; c < 3; c++)
+			p.v[c] += uniform(generator);
+		velocities[i] = swirl_velocity(p, center);
+		if (with_vorticity)
+			vorticities[i] = swirl_vorticity(p, center);
+		for (int c = 0; c < 3; c++)
+			voxel_positions[i].v[c] = p.v[c] + velocities[i].v[c] * time;
+	}
+
+	std::vector<size_t> order;
+	PointTileRangeContainer tiles;
+	if (!build_point_tiles(component, voxel_positions, order, tiles))
+		return false;
+	if (!write_synth_channel<amino::Math::vec3f>(ss, component, Bifrost::API::FloatV3Type, "position", voxel_positions, order, tiles))
+		return false;
+
+	for (size_t channelIndex = 0; channelIndex < options.channels.size(); channelIndex++)
+	{
+		const std::string& channel_name = options.channels[channelIndex];
+		if (channel_name == "position")
+			continue;
+		bool written = false;
+		switch (synth_channel_type(channel_name))
+		{
+		case Bifrost::API::FloatV3Type:
+			written = write_synth_channel<amino::Math::vec3f>(ss, component, Bifrost::API::FloatV3Type, channel_name,
+															  channel_name == "vorticity" ? vorticities : velocities, order, tiles);
+			break;
+		case Bifrost::API::UInt64Type:
+			{
+				std::vector<uint64_t> ids(options.point_count);
+				for (size_t i = 0; i < options.point_count; i++)
+					ids[i] = i;
+				written = write_synth_channel<uint64_t>(ss, component, Bifrost::API::UInt64Type, channel_name, ids, order, tiles);
+			}
+			break;
+		default:
+			{
+				std::vector<float> values(options.point_count);
+				for (size_t i = 0; i < options.point_count; i++)
+					values[i] = density_field(voxel_positions[i], center);
+				written = write_synth_channel<float>(ss, component, Bifrost::API::FloatType, channel_name, values, order, tiles);
+			}
+			break;
+		}
+		if (!written)
+			return false;
+	}
+
+	Bifrost::API::FileIO fileio = om.createFileIO(filename.c_str());
+	Bifrost::API::Status status = fileio.save(component, Bifrost::API::BIF::Compression::Level0, 0);
+	if (!status.succeeded())
+	{
+		std::cerr << boost::format("bifsynth : unable to save \"%1%\"") % filename << std::endl;
+		return false;
+	}
+
+	std::cout << boost::format("bifsynth : wrote %1% points in %2% tiles to \"%3%\"")
+		% options.point_count % tiles.size() % filename << std::endl;
+	return true;
+}
+
+/*!
+ * \brief Dense leaf tiles at the occupied tile corners, the fields scroll
+ *        along the swirl by the frame time
+ */
+bool synth_voxels(const SynthOptions& options, size_t frame, const std::string& filename)
+{
+	Bifrost::API::ObjectModel om;
+	Bifrost::API::StateServer ss = om.createStateServer();
+	Bifrost::API::Layout layout = ss.createLayout("bifsynth_layout", options.voxel_scale);
+	Bifrost::API::Component component = ss.createComponent(Bifrost::API::VoxelComponentType,
+														   "bifsynth-voxel",
+														   layout);
+	if (!component.valid())
+	{
+		std::cerr << "bifsynth : unable to create the Bifrost voxel component" << std::endl;
+		return false;
+	}
+
+	Bifrost::API::TileDimInfo tile_dim_info = layout.tileDimInfo(layout.maxDepth());
+	const size_t tile_width = tile_dim_info.tileWidth;
+	const size_t tile_size = tile_dim_info.tileSize;
+	const float tile_voxel_width = tile_width * tile_dim_info.voxelWidth;
+	std::vector<amino::Math::vec3f> corners;
+	select_occupied_tiles(options, tile_voxel_width, corners);
+
+	StringContainer channel_names(options.channels);
+	if (channel_names.empty())
+		channel_names.push_back("density");
+	std::vector<Bifrost::API::Channel> channels;
+	for (size_t channelIndex = 0; channelIndex < channel_names.size(); channelIndex++)
+	{
+		// Voxel channels are fields, the id channel of points has no meaning here
+		Bifrost::API::DataType data_type = synth_channel_type(channel_names[channelIndex]);
+		if (data_type == Bifrost::API::UInt64Type)
+			data_type = Bifrost::API::FloatType;
+		Bifrost::API::Channel channel = ss.createChannel(component, data_type, channel_names[channelIndex].c_str());
+		if (!channel.valid())
+		{
+			std::cerr << boost::format("bifsynth : unable to create channel '%1%'") % channel_names[channelIndex] << std::endl;
+			return false;
+		}
+		channels.push_back(channel);
+	}
+
+	const float center = 0.5f * options.tile_grid * tile_voxel_width;
+	const float time = frame / options.fps;
+	Bifrost::API::TileAccessor accessor = layout.tileAccessor();
+	std::vector<float> scalars(tile_size);
+	std::vector<amino::Math::vec3f> vectors(tile_size);
+	const bool with_vorticity = std::find(channel_names.begin(), channel_names.end(), "vorticity") != channel_names.end();
+	std::vector<amino::Math::vec3f> vorticities(with_vorticity ? tile_size : 0);
+	for (size_t tileIndex = 0; tileIndex < corners.size(); tileIndex++)
+	{
+		const amino::Math::vec3f& corner = corners[tileIndex];
+		Bifrost::API::TreeIndex tindex = accessor.addTile(static_cast<int>(corner.v[0]),
+														  static_cast<int>(corner.v[1]),
+														  static_cast<int>(corner.v[2]));
+		if (!tindex.valid())
+		{
+			std::cerr << boost::format("bifsynth : unable to add tile [%1%,%2%,%3%]") % corner.v[0] % corner.v[1] % corner.v[2] << std::endl;
+			return false;
+		}
+		component.setElementCount(tindex, tile_size);
+
+		for (size_t v = 0; v < tile_size; v++)
+		{
+			amino::Math::vec3f p;
+			p.v[0] = corner.v[0] + (v % tile_width) * tile_dim_info.voxelWidth;
+			p.v[1] = corner.v[1] + ((v / tile_width) % tile_width) * tile_dim_info.voxelWidth;
+			p.v[2] = corner.v[2] + (v / (tile_width * tile_width)) * tile_dim_info.voxelWidth;
+			vectors[v] = swirl_velocity(p, center);
+			if (with_vorticity)
+				vorticities[v] = swirl_vorticity(p, center);
+			for (int c = 0; c < 3; c++)
+				p.v[c] -= vectors[v].v[c] * time;
+			scalars[v] = density_field(p, center);
+		}
+		for (size_t channelIndex = 0; channelIndex < channels.size(); channelIndex++)
+		{
+			const bool written = channels[channelIndex].dataType() == Bifrost::API::FloatV3Type
+				? channels[channelIndex].setTileData<amino::Math::vec3f>(tindex, tile_size,
+																		 channel_names[channelIndex] == "vorticity" ? &vorticities[0] : &vectors[0])
+				: channels[channelIndex].setTileData<float>(tindex, tile_size, &scalars[0]);
+			if (!written)
+				return false;
+		}
+	}
+
+	Bifrost::API::FileIO fileio = om.createFileIO(filename.c_str());
+	Bifrost::API::Status status = fileio.save(component, Bifrost::API::BIF::Compression::Level0, 0);
+	if (!status.succeeded())
+	{
+		std::cerr << boost::format("bifsynth : unable to save \"%1%\"") % filename << std::endl;
+		return false;
+	}
+
+	std::cout << boost::format("bifsynth : wrote %1% voxels in %2% tiles to \"%3%\"")
+		% (corners.size() * tile_size) % corners.size() % filename << std::endl;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	try {
+		SynthOptions options;
+		std::string component_type("points");
+		po::options_description desc("Allowed options");
+		desc.add_options()
+			("help", "produce help message")
+			("type", po::value<std::string>(&component_type), "component to write, points or voxels (default points)")
+			("output", po::value<std::string>(&options.output), "Bifrost file to write, a printf pattern such as fixture.%04d.bif when --frames > 1")
+			("points", po::value<size_t>(&options.point_count), "number of points (default 1000000)")
+			("tiles", po::value<size_t>(&options.tile_grid), "tiles per side of the cube of candidate tiles (default 8)")
+			("sparsity", po::value<float>(&options.sparsity), "fraction of the candidate tiles left empty, between 0 and 1 (default 0)")
+			("channel", po::value<StringContainer>(&options.channels), "channel to write, repeatable. velocity and vorticity (its curl) are vectors, id64 point ids, other names scalar fields")
+			("voxel-scale", po::value<float>(&options.voxel_scale), "layout voxel scale (default 0.1)")
+			("frames", po::value<size_t>(&options.frames), "number of frames of the sequence (default 1)")
+			("fps", po::value<float>(&options.fps), "frames per second of the motion between frames (default 24)")
+			("seed", po::value<unsigned>(&options.seed), "random seed (default 1)")
+			;
+
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+		po::notify(vm);
+
+		if (vm.count("help") || options.output.empty()) {
+			std::cout << desc << "\n";
+			return 1;
+		}
+		if (component_type != "points" && component_type != "voxels")
+		{
+			std::cerr << boost::format("bifsynth : unknown component type \"%1%\"") % component_type << std::endl;
+			return 1;
+		}
+		options.voxels = component_type == "voxels";
+		options.sparsity = std::min(std::max(options.sparsity, 0.0f), 1.0f);
+		if (options.fps <= 0.0f || options.voxel_scale <= 0.0f)
+		{
+			std::cerr << "bifsynth : --fps and --voxel-scale must be positive" << std::endl;
+			return 1;
+		}
+
+		for (size_t frame = 0; frame < options.frames; frame++)
+		{
+			const std::string filename = options.frames > 1
+				? (boost::format(options.output) % (frame + 1)).str()
+				: options.output;
+			const bool written = options.voxels
+				? synth_voxels(options, frame, filename)
+				: synth_points(options, frame, filename);
+			if (!written)
+				return 1;
+		}
+	}
+	catch (std::exception& e) {
+		std::cerr << "error: " << e.what() << "\n";
+		return 1;
+	}
+	catch (...) {
+		std::cerr << "Exception of unknown type!\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -1,10 +1,13 @@
 #include <utils/BifrostUtils.h>
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <stdint.h>
+#include <stdio.h>
 #include <OpenEXR/ImathBox.h>
 
 #include <BifrostHeaders.h>
@@ -21,27 +24,6 @@ std::ostream& operator<<(std::ostream& os, const std::vector<T>& v)
 	return os;
 }
 
-void Box2WavefrontString(const Imath::V3f o_box[8], std::string& o_obj_string)
-{
-	std::ostringstream oss;
-	const size_t vertex_count = 8;
-	oss << "g" << std::endl;
-	for (size_t index = 0; index < vertex_count; index++ )
-	{
-		oss << boost::format("v %1% %2% %3%") % o_box[index].x % o_box[index].y % o_box[index].z << std::endl;
-	}
-	oss << "g" << std::endl;
-	// right handed coordinate system, indices starts from 1
-	oss << "f 1 2 3 4" << std::endl; // front
-	oss << "f 1 5 6 2" << std::endl; // top
-	oss << "f 2 6 7 3" << std::endl; // left
-	oss << "f 1 4 8 5" << std::endl; // right
-	oss << "f 3 7 8 4" << std::endl; // bottom
-	oss << "f 5 8 7 6" << std::endl; // back
-
-	o_obj_string = oss.str();
-}
-
 void Centroid2Box(float centroid_x, float centroid_y, float centroid_z,
 				  float tile_width, float voxel_scale, Imath::V3f o_bbox[8])
 {
@@ -67,7 +49,151 @@ void Centroid2Box(float centroid_x, float centroid_y, float centroid_z,
 	o_bbox[7] = Imath::V3f(offset_x + x + half_width, offset_y + y - half_width, offset_z + z - half_width);
 }
 
-void process_VoxelComponentType(const Bifrost::API::Component& component)
+/*!
+ * \brief Where and how the tile boxes of the voxel components are written
+ * \note Alembic is only found when BUILD_ALEMBIC_TOOLS is set and only
+ *       bif2abc links it, the dev tools are always built so Alembic curves
+ *       are left to bif2abc
+ */
+struct TileExportOptions
+{
+	TileExportOptions() : filename("voxel_tiles.obj"), color_by_count(false) {}
+	std::string filename; //!< a .ply extension selects binary PLY, anything else OBJ
+	bool color_by_count; //!< vertex colors ramping from blue (empty) to red (fullest tile)
+};
+
+/*!
+ * \brief One tile box, min corner and edge length in world space
+ */
+struct TileBox
+{
+	float min[3];
+	float width;
+	size_t element_count;
+	size_t depth;
+};
+typedef std::vector<TileBox> TileBoxContainer;
+
+// Quad corners of a box, the same winding as the OBJ export had per tile
+static const int box_faces[6][4] = {
+	{ 0, 1, 2, 3 }, // front
+	{ 0, 4, 5, 1 }, // top
+	{ 1, 5, 6, 2 }, // left
+	{ 0, 3, 7, 4 }, // right
+	{ 2, 6, 7, 3 }, // bottom
+	{ 4, 7, 6, 5 }  // back
+};
+
+void TileBoxCorners(const TileBox& tile_box, Imath::V3f o_box[8])
+{
+	Centroid2Box(tile_box.min[0], tile_box.min[1], tile_box.min[2], tile_box.width, 1.0f, o_box);
+}
+
+void TileBoxColor(const TileBox& tile_box, size_t max_element_count, unsigned char o_rgb[3])
+{
+	const float t = max_element_count ? float(tile_box.element_count) / float(max_element_count) : 0.0f;
+	o_rgb[0] = static_cast<unsigned char>(255.0f * t + 0.5f);
+	o_rgb[1] = 0;
+	o_rgb[2] = static_cast<unsigned char>(255.0f * (1.0f - t) + 0.5f);
+}
+
+bool WriteTileBoxesOBJ(const TileBoxContainer& tile_boxes, const TileExportOptions& options, size_t max_element_count)
+{
+	FILE* file = fopen(options.filename.c_str(), "w");
+	if (!file)
+	{
+		std::cerr << boost::format("Unable to open \"%1%\" for writing") % options.filename << std::endl;
+		return false;
+	}
+	std::vector<char> io_buffer(4 << 20);
+	setvbuf(file, &io_buffer[0], _IOFBF, io_buffer.size());
+
+	fprintf(file, "# %lu Bifrost tiles\n", static_cast<unsigned long>(tile_boxes.size()));
+	for (size_t index = 0; index < tile_boxes.size(); index++)
+	{
+		Imath::V3f box[8];
+		TileBoxCorners(tile_boxes[index], box);
+		unsigned char rgb[3];
+		TileBoxColor(tile_boxes[index], max_element_count, rgb);
+		fprintf(file, "g depth%lu\n", static_cast<unsigned long>(tile_boxes[index].depth));
+		for (size_t corner = 0; corner < 8; corner++)
+		{
+			if (options.color_by_count)
+				fprintf(file, "v %g %g %g %g %g %g\n", box[corner].x, box[corner].y, box[corner].z,
+						rgb[0] / 255.0f, rgb[1] / 255.0f, rgb[2] / 255.0f);
+			else
+				fprintf(file, "v %g %g %g\n", box[corner].x, box[corner].y, box[corner].z);
+		}
+		// right handed coordinate system, indices starts from 1
+		const unsigned long base = static_cast<unsigned long>(index * 8 + 1);
+		for (size_t face = 0; face < 6; face++)
+			fprintf(file, "f %lu %lu %lu %lu\n",
+					base + box_faces[face][0], base + box_faces[face][1],
+					base + box_faces[face][2], base + box_faces[face][3]);
+	}
+	const bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
+
+bool WriteTileBoxesPLY(const TileBoxContainer& tile_boxes, const TileExportOptions& options, size_t max_element_count)
+{
+	FILE* file = fopen(options.filename.c_str(), "wb");
+	if (!file)
+	{
+		std::cerr << boost::format("Unable to open \"%1%\" for writing") % options.filename << std::endl;
+		return false;
+	}
+	std::vector<char> io_buffer(4 << 20);
+	setvbuf(file, &io_buffer[0], _IOFBF, io_buffer.size());
+
+	const uint16_t endian_probe = 1;
+	const bool little_endian = *reinterpret_cast<const unsigned char*>(&endian_probe) == 1;
+	fprintf(file, "ply\nformat %s 1.0\n", little_endian ? "binary_little_endian" : "binary_big_endian");
+	fprintf(file, "comment %lu Bifrost tiles\n", static_cast<unsigned long>(tile_boxes.size()));
+	fprintf(file, "element vertex %lu\n", static_cast<unsigned long>(tile_boxes.size() * 8));
+	fprintf(file, "property float x\nproperty float y\nproperty float z\n");
+	if (options.color_by_count)
+		fprintf(file, "property uchar red\nproperty uchar green\nproperty uchar blue\n");
+	fprintf(file, "element face %lu\n", static_cast<unsigned long>(tile_boxes.size() * 6));
+	fprintf(file, "property list uchar int vertex_indices\nend_header\n");
+
+	for (size_t index = 0; index < tile_boxes.size(); index++)
+	{
+		Imath::V3f box[8];
+		TileBoxCorners(tile_boxes[index], box);
+		unsigned char rgb[3];
+		TileBoxColor(tile_boxes[index], max_element_count, rgb);
+		for (size_t corner = 0; corner < 8; corner++)
+		{
+			const float xyz[3] = { box[corner].x, box[corner].y, box[corner].z };
+			fwrite(xyz, sizeof(float), 3, file);
+			if (options.color_by_count)
+				fwrite(rgb, 1, 3, file);
+		}
+	}
+	for (size_t index = 0; index < tile_boxes.size(); index++)
+	{
+		const int32_t base = static_cast<int32_t>(index * 8);
+		for (size_t face = 0; face < 6; face++)
+		{
+			const unsigned char corner_count = 4;
+			const int32_t quad[4] = { base + box_faces[face][0], base + box_faces[face][1],
+									  base + box_faces[face][2], base + box_faces[face][3] };
+			fwrite(&corner_count, 1, 1, file);
+			fwrite(quad, sizeof(int32_t), 4, file);
+		}
+	}
+	const bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
+
+/*!
+ * \brief Gather the boxes of the tiles of all depths of a voxel component
+ *        in one traversal, element counts come from the first channel
+ */
+void process_VoxelComponentType(const Bifrost::API::Component& component, TileBoxContainer& tile_boxes)
 {
 	std::cout << "process_VoxelComponentType() START" << std::endl;
 	Bifrost::API::Layout layout = component.layout();
@@ -78,53 +204,33 @@ void process_VoxelComponentType(const Bifrost::API::Component& component)
 	Bifrost::API::RefArray channel_array = component.channels();
 	size_t num_channels = channel_array.count();
 	std::cout << boost::format("process_VoxelComponentType() number of channels %1%") % num_channels << std::endl;
-	size_t channel_index = 0;
-	Bifrost::API::TileDimInfo tile_dim_info = layout.tileDimInfo(max_depth);
-	const float tile_width = tile_dim_info.tileWidth;
-	// std::cout << boost::format("process_VoxelComponentType() tile_dim_info.tileWidth %1%") % tile_dim_info.tileWidth << std::endl;
-	// std::cout << boost::format("process_VoxelComponentType() tile_dim_info.tileSize %1%") % tile_dim_info.tileSize << std::endl;
 
-	// for (size_t channel_index = 0; channel_index < num_channels; ++channel_index)
-	{
-		const Bifrost::API::Channel current_channel = channel_array[channel_index];
-		Bifrost::API::TileIterator tIter = layout.tileIterator(max_depth, max_depth, Bifrost::API::TraversalMode::DepthFirst);
-		int tile_index = 0;
-		while (tIter)
-		{
-			// std::string i_obj_filename = "voxel_tiles.%04d.obj";
-			char i_obj_filename[64];
-			sprintf(i_obj_filename, "voxel_tiles.%04d.obj", tile_index);
-			std::ofstream wavefront_file;
-			wavefront_file.open(i_obj_filename);
-			wavefront_file << "# yue.nicholas@gmail.com\n";
-
-			Bifrost::API::Tile tile = *tIter;
-			Bifrost::API::TileInfo info = tile.info();
-
-			// log the tile info
-			std::cout << "tile id: " << info.id << std::endl;
-			std::cout << "	tile is valid: " << info.valid << std::endl;
-			std::cout << "	tile space coordinates: " << info.i << ", " << info.j << ", " << info.k << std::endl;
-			std::cout << "	tile index: " << info.tile << ":" << info.depth << std::endl;
-			std::cout << "	tile parent: " << info.parent << std::endl;
-			std::cout << "	tile has children: " << info.hasChildren << std::endl;
-
-			Imath::V3f box[8];
-			std::string obj_string;
-			Centroid2Box(info.i, info.j, info.k, tile_width, voxel_scale, box);
-			Box2WavefrontString(box, obj_string);
-			wavefront_file << obj_string.c_str();
-
-			tile_index++;
-			++tIter;
-
-			wavefront_file.close();
-		}
+	Bifrost::API::Channel count_channel;
+	if (num_channels > 0)
+		count_channel = channel_array[0];
 
-		std::cout << boost::format("process_VoxelComponentType() tile_index %1%") % tile_index << std::endl;
+	const size_t first_tile = tile_boxes.size();
+	Bifrost::API::TileIterator tIter = layout.tileIterator(0, max_depth, Bifrost::API::TraversalMode::DepthFirst);
+	while (tIter)
+	{
+		Bifrost::API::Tile tile = *tIter;
+		Bifrost::API::TileInfo info = tile.info();
+
+		// i, j, k are the tile origin in voxels of the finest depth
+		TileBox tile_box;
+		tile_box.min[0] = info.i * voxel_scale;
+		tile_box.min[1] = info.j * voxel_scale;
+		tile_box.min[2] = info.k * voxel_scale;
+		tile_box.width = info.dimInfo.tileWidth * info.dimInfo.voxelWidth * voxel_scale;
+		tile_box.depth = info.depth;
+		tile_box.element_count = count_channel.valid() ? count_channel.elementCount(Bifrost::API::TreeIndex(info.tile, info.depth)) : 0;
+		tile_boxes.push_back(tile_box);
+
+		++tIter;
 	}
-}
 
+	std::cout << boost::format("process_VoxelComponentType() tile count %1%") % (tile_boxes.size() - first_tile) << std::endl;
+}
 
 void process_VoxelComponentType_old(const Bifrost::API::Component& component)
 {
@@ -245,7 +351,7 @@ void process_VoxelComponentType_old(const Bifrost::API::Component& component)
 	std::cout << "process_VoxelComponentType() END" << std::endl;
 }
 
-int process_bifrost_voxel(const std::string& bifrost_filename)
+int process_bifrost_voxel(const std::string& bifrost_filename, const TileExportOptions& export_options)
 {
 	// using namespace Bifrost::API;
 
@@ -278,6 +384,7 @@ int process_bifrost_voxel(const std::string& bifrost_filename)
 			channel_names.push_back(channelInfo.name);
 		}
 
+		TileBoxContainer tile_boxes;
 		size_t numComponents = ss.components().count();
 		std::cout << boost::format("StateServer components count : %1%") % numComponents << std::endl;
 		for (size_t componentIndex = 0; componentIndex<numComponents; componentIndex++)
@@ -287,10 +394,21 @@ int process_bifrost_voxel(const std::string& bifrost_filename)
 			std::cout << boost::format("component[%1%] of type %2%") % componentIndex % componentType << std::endl;
 			if (componentType == Bifrost::API::VoxelComponentType)
 			{
-				process_VoxelComponentType(component);
+				process_VoxelComponentType(component, tile_boxes);
 			}
 		}
 
+		size_t max_element_count = 0;
+		for (size_t index = 0; index < tile_boxes.size(); index++)
+			max_element_count = std::max(max_element_count, tile_boxes[index].element_count);
+		const std::string& filename = export_options.filename;
+		const bool ply = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".ply") == 0;
+		const bool written = ply ? WriteTileBoxesPLY(tile_boxes, export_options, max_element_count)
+			: WriteTileBoxesOBJ(tile_boxes, export_options, max_element_count);
+		if (!written)
+			return 1;
+		std::cout << boost::format("Wrote %1% tile boxes to %2%") % tile_boxes.size() % filename << std::endl;
+
 
 	}
 
@@ -303,12 +421,16 @@ int main(int argc, char **argv)
 	try {
 		typedef std::vector<std::string> StringContainer;
 		std::string bifrost_filename;
+		TileExportOptions export_options;
 		po::options_description desc("Allowed options");
 		desc.add_options()
 			("version", "print version string")
 			("help", "produce help message")
 			("input-file", po::value<std::vector<std::string> >(),
 					"input files")
+			("tiles-output", po::value<std::string>(&export_options.filename),
+					"file receiving the boxes of all tiles, binary PLY for a .ply extension, OBJ otherwise (default voxel_tiles.obj)")
+			("color-by-count", "color the tile boxes by element count")
 			;
 
 		po::positional_options_description p;
@@ -318,6 +440,7 @@ int main(int argc, char **argv)
 		po::store(po::command_line_parser(argc, argv).options(desc).positional(p).run(), vm);
 		po::notify(vm);
 
+		export_options.color_by_count = vm.count("color-by-count") > 0;
 		if (vm.count("help")) {
 			std::cout << desc << "\n";
 			return 1;
@@ -338,7 +461,7 @@ int main(int argc, char **argv)
 		}
 		if (bifrost_filename.size() > 0)
 		{
-			process_bifrost_voxel(bifrost_filename);
+			return process_bifrost_voxel(bifrost_filename, export_options);
 		}
 		else
 		{
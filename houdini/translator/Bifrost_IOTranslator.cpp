@@ -1,6 +1,13 @@
 #include "Bifrost_IOTranslator.h"
 #include <string.h>
 #include <boost/format.hpp>
+#include <HoudiniGeo2Bifrost.h>
+#include <utils/BifrostUtils.h>
+#include <openvdb/openvdb.h>
+#include <openvdb/tools/Dense.h>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
 
 typedef std::vector<amino::Math::vec3f> V3fContainer;
 typedef std::vector<float> FloatContainer;
@@ -47,9 +54,9 @@ const char *
 Bifrost_IOTranslator::formatName() const
 {
 #ifdef WIN32
-	return "Autodesk Maya Bifrost Format v2 (Read-Only) \n\tExtensions: .bif";
+	return "Autodesk Maya Bifrost Format v2 \n\tExtensions: .bif";
 #else
-    return (boost::format("Autodesk Maya Bifrost Format v2 (Read-Only) built : %1% %2%\n\tExtensions: .bif") % __DATE__ % __TIME__).str().c_str();
+    return (boost::format("Autodesk Maya Bifrost Format v2 built : %1% %2%\n\tExtensions: .bif") % __DATE__ % __TIME__).str().c_str();
 #endif
 }
 
@@ -106,6 +113,180 @@ bool Bifrost_IOTranslator::processChannelData(Bifrost::API::Component& component
 	return true;
 }
 
+namespace {
+
+inline float toVDBValue(float value)
+{
+	return value;
+}
+
+inline openvdb::Vec3f toVDBValue(const amino::Math::vec3f& value)
+{
+	return openvdb::Vec3f(value.v[0],value.v[1],value.v[2]);
+}
+
+}
+
+template<typename GridType, typename T>
+typename GridType::Ptr Bifrost_IOTranslator::processVoxelChannelData(const Bifrost::API::Layout& layout,
+																	  const Bifrost::API::Channel& channel,
+																	  const std::vector< std::vector<Bifrost::API::Tile> >& depth_tiles) const
+{
+	typedef typename GridType::ValueType ValueType;
+	typedef tbb::enumerable_thread_specific<typename GridType::Ptr> ThreadGridContainer;
+
+	const ValueType background = openvdb::zeroVal<ValueType>();
+	typename GridType::Ptr grid = GridType::create(background);
+	for (size_t depth=0; depth<depth_tiles.size(); depth++)
+	{
+		const std::vector<Bifrost::API::Tile>& tiles = depth_tiles[depth];
+		ThreadGridContainer thread_grids([&background]() { return GridType::create(background); });
+
+		tbb::parallel_for(tbb::blocked_range<size_t>(0,tiles.size()),
+			[&](const tbb::blocked_range<size_t>& r)
+			{
+				typename GridType::Ptr thread_grid = thread_grids.local();
+				std::vector<ValueType> tile_values;
+				for (size_t t=r.begin(); t!=r.end(); ++t)
+				{
+					const Bifrost::API::Tile& tile = tiles[t];
+					Bifrost::API::TreeIndex tindex = tile.index();
+					if ( !channel.elementCount( tindex ) )
+						continue;
+					const Bifrost::API::TileInfo info = tile.info();
+					const int tile_width = static_cast<int>(info.dimInfo.tileWidth);
+					const int voxel_width = static_cast<int>(info.dimInfo.voxelWidth);
+					const Bifrost::API::TileData<T> data_element = channel.tileData<T>( tindex );
+					const size_t tile_size = static_cast<size_t>(tile_width) * tile_width * tile_width;
+					if (data_element.count() < tile_size)
+						continue;
+
+					// Bifrost tile data is x fastest, the same order as the XYZ dense layout
+					tile_values.resize(tile_size);
+					bool constant = true;
+					for (size_t index=0; index<tile_size; index++ ) {
+						tile_values[index] = toVDBValue(data_element[index]);
+						constant = constant && tile_values[index] == tile_values[0];
+					}
+
+					const openvdb::Coord origin(info.i, info.j, info.k);
+					if (constant)
+					{
+						// One fill covers the whole tile, coarse tiles are often uniform
+						if (tile_values[0] != background)
+							thread_grid->fill(openvdb::CoordBBox(origin,origin.offsetBy(tile_width*voxel_width-1)),tile_values[0],true);
+					}
+					else if (voxel_width == 1)
+					{
+						openvdb::tools::Dense<ValueType,openvdb::tools::LayoutXYZ> dense(openvdb::CoordBBox(origin,origin.offsetBy(tile_width-1)),
+																						&tile_values[0]);
+						openvdb::tools::copyFromDense(dense,*thread_grid,openvdb::zeroVal<ValueType>(),true);
+					}
+					else
+					{
+						size_t index = 0;
+						for (int k=0; k<tile_width; k++ ) {
+							for (int j=0; j<tile_width; j++ ) {
+								for (int i=0; i<tile_width; i++, index++ ) {
+									if (tile_values[index] == background)
+										continue;
+									openvdb::Coord voxel_origin(info.i + i*voxel_width,
+																info.j + j*voxel_width,
+																info.k + k*voxel_width);
+									thread_grid->fill(openvdb::CoordBBox(voxel_origin,voxel_origin.offsetBy(voxel_width-1)),tile_values[index],true);
+								}
+							}
+						}
+					}
+				}
+			});
+
+		// A finer tile replaces the voxels of its parent over its whole extent,
+		// the parent voxels outside of the allocated children are kept
+		if (depth > 0)
+		{
+			for (size_t t=0; t<tiles.size(); t++)
+			{
+				const Bifrost::API::TileInfo info = tiles[t].info();
+				const size_t tile_width = info.dimInfo.tileWidth;
+				// Same test as above, a tile left out keeps its parent voxels
+				if ( channel.elementCount( tiles[t].index() ) < tile_width * tile_width * tile_width )
+					continue;
+				const openvdb::Coord origin(info.i, info.j, info.k);
+				const int extent = static_cast<int>(tile_width * info.dimInfo.voxelWidth);
+				grid->fill(openvdb::CoordBBox(origin,origin.offsetBy(extent-1)),background,false);
+			}
+		}
+		// Tiles of one depth are disjoint, merging the active states is exact
+		for (typename ThreadGridContainer::iterator it = thread_grids.begin(); it != thread_grids.end(); ++it)
+			grid->tree().merge((*it)->tree(),openvdb::MERGE_ACTIVE_STATES);
+	}
+
+	// Bifrost voxels are cell centered
+	const double voxel_scale = layout.voxelScale();
+	openvdb::math::Transform::Ptr transform = openvdb::math::Transform::createLinearTransform(voxel_scale);
+	transform->postTranslate(openvdb::Vec3d(0.5*voxel_scale));
+	grid->setTransform(transform);
+	grid->pruneGrid();
+	return grid;
+}
+
+bool Bifrost_IOTranslator::processVoxelComponent(GEO_Detail *gdp,
+												 const Bifrost::API::Component& component) const
+{
+	GU_Detail *gu_detail = dynamic_cast<GU_Detail*>(gdp);
+	if (!gu_detail)
+	{
+		std::cerr << "Voxel components can only be loaded into a GU_Detail" << std::endl;
+		return false;
+	}
+	openvdb::initialize();
+
+	// Collect the tiles of every depth once, all channels share the tile
+	// tree. Parent tiles are kept, on adaptive caches their children may
+	// only cover part of them
+	Bifrost::API::Layout layout = component.layout();
+	std::vector< std::vector<Bifrost::API::Tile> > depth_tiles(layout.maxDepth() + 1);
+	Bifrost::API::TileIterator tIter = layout.tileIterator(0, layout.maxDepth(), Bifrost::API::BreadthFirst);
+	while (tIter)
+	{
+		Bifrost::API::Tile tile = *tIter;
+		const size_t depth = tile.info().depth;
+		if (depth < depth_tiles.size())
+			depth_tiles[depth].push_back(tile);
+		++tIter;
+	}
+
+	Bifrost::API::RefArray channels = component.channels();
+	for (size_t channelIndex=0;channelIndex<channels.count();channelIndex++)
+	{
+		const Bifrost::API::Channel& channel = channels[channelIndex];
+		std::string grid_name = channel_short_name(channel.name().c_str());
+		if (grid_name == "velocity")
+			grid_name = "vel";
+
+		switch (channel.dataType())
+		{
+		case		Bifrost::API::FloatType:
+			{
+				openvdb::FloatGrid::Ptr grid = processVoxelChannelData<openvdb::FloatGrid,float>(layout,channel,depth_tiles);
+				GU_PrimVDB::buildFromGrid(*gu_detail,grid,NULL,grid_name.c_str());
+			}
+			break;
+		case		Bifrost::API::FloatV3Type:
+			{
+				openvdb::Vec3SGrid::Ptr grid = processVoxelChannelData<openvdb::Vec3SGrid,amino::Math::vec3f>(layout,channel,depth_tiles);
+				grid->setVectorType(openvdb::VEC_CONTRAVARIANT_RELATIVE);
+				GU_PrimVDB::buildFromGrid(*gu_detail,grid,NULL,grid_name.c_str());
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
 GA_Detail::IOStatus
 Bifrost_IOTranslator::fileLoad(GEO_Detail *gdp, UT_IStream &is, bool ate_magic)
 {
@@ -124,12 +305,18 @@ Bifrost_IOTranslator::fileLoad(GEO_Detail *gdp, UT_IStream &is, bool ate_magic)
 	}
 
 	Bifrost::API::Component component = ss.components()[0];
+	if ( component.type() == Bifrost::API::VoxelComponentType ) {
+		return GA_Detail::IOStatus(processVoxelComponent(gdp,component));
+	}
 	if ( component.type() != Bifrost::API::PointComponentType ) {
 		std::cerr << "Wrong component (" << component.type() << ")" << std::endl;
 	    return GA_Detail::IOStatus(false);
 	}
 
-	// float bifrost_scale = 0.0;
+	// Saving the detail back writes the same layout voxel scale
+	GA_RWHandleF voxel_scale_handle(gdp->addFloatTuple(GA_ATTRIB_DETAIL, HoudiniGeo2Bifrost::VOXEL_SCALE_ATTRIBUTE_NAME, 1));
+	if (voxel_scale_handle.isValid())
+		voxel_scale_handle.set(GA_Offset(0), component.layout().voxelScale());
 
 	Bifrost::API::RefArray channels = component.channels();
 	// We must process the point position first as this will setup the correct
@@ -344,6 +531,13 @@ Bifrost_IOTranslator::fileSave(const GEO_Detail *gdp, std::ostream &os)
     return GA_Detail::IOStatus(false);
 }
 
+GA_Detail::IOStatus
+Bifrost_IOTranslator::fileSaveToFile(const GEO_Detail *gdp, const char *fname)
+{
+    HoudiniGeo2Bifrost h2b(fname, HoudiniGeo2Bifrost::detailVoxelScale(gdp));
+    return GA_Detail::IOStatus(h2b.process(gdp));
+}
+
 void
 newGeometryIO(void *)
 {
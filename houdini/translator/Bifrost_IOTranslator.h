@@ -3,6 +3,7 @@
 // Houdini header - START
 #include <GU/GU_Detail.h>
 #include <GU/GU_PrimVolume.h>
+#include <GU/GU_PrimVDB.h>
 #include <GEO/GEO_AttributeHandle.h>
 #include <GEO/GEO_IOTranslator.h>
 #include <SOP/SOP_Node.h>
@@ -18,7 +19,10 @@
 #include <bifrostapi/bifrost_fileutils.h>
 #include <bifrostapi/bifrost_string.h>
 #include <bifrostapi/bifrost_channel.h>
+#include <bifrostapi/bifrost_tile.h>
 #include <bifrostapi/bifrost_tiledata.h>
+#include <bifrostapi/bifrost_tileaccessor.h>
+#include <bifrostapi/bifrost_tileiterator.h>
 #include <bifrostapi/bifrost_types.h>
 #include <bifrostapi/bifrost_layout.h>
 // Bifrost headers - END
@@ -51,6 +55,19 @@ class Bifrost_IOTranslator : public GEO_IOTranslator
 							Bifrost::API::Channel& velocity_channel,
 							bool i_is_point_position,
 							std::vector<T>& o_channel_data_array) const;
+
+	/*!
+	 * \brief Converts one voxel channel to a sparse VDB grid, tile by tile
+	 * \note Depths are converted from coarse to fine, the tiles of a depth
+	 *       are written as dense blocks on their own thread and the per-thread
+	 *       trees merged, each finer tile replacing its region of the parents
+	 */
+	template<typename GridType, typename T>
+	typename GridType::Ptr processVoxelChannelData(const Bifrost::API::Layout& layout,
+												   const Bifrost::API::Channel& channel,
+												   const std::vector< std::vector<Bifrost::API::Tile> >& depth_tiles) const;
+	bool processVoxelComponent(GEO_Detail *gdp,
+							   const Bifrost::API::Component& component) const;
 public:
 	Bifrost_IOTranslator();
 	Bifrost_IOTranslator(const Bifrost_IOTranslator &src);
@@ -63,8 +80,15 @@ public:
     virtual GA_Detail::IOStatus  fileLoad(GEO_Detail *, UT_IStream &,
                                           bool ate_magic);
     /*!
-     * \brief Saving to Bifrost is not support
+     * \brief Bifrost FileIO only writes to named files, saving to a stream is not supported
      * \return Returning false
      */
     virtual GA_Detail::IOStatus  fileSave(const GEO_Detail *, std::ostream &);
+    /*!
+     * \brief Writes the detail points as a Bifrost point component via HoudiniGeo2Bifrost
+     * \note The layout voxel scale is taken from the bifrost_voxel_scale detail
+     *       attribute, set when a Bifrost file is loaded or by the user before
+     *       the ROP, 0.1 without it
+     */
+    virtual GA_Detail::IOStatus  fileSaveToFile(const GEO_Detail *, const char *);
 };
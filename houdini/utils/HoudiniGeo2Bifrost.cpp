@@ -1,6 +1,42 @@
 #include "HoudiniGeo2Bifrost.h"
+#include <boost/format.hpp>
 
-HoudiniGeo2Bifrost::HoudiniGeo2Bifrost()
+// Houdini header - START
+#include <GEO/GEO_Detail.h>
+#include <GA/GA_AttributeDict.h>
+#include <GA/GA_Handle.h>
+#include <UT/UT_Vector2.h>
+#include <UT/UT_Vector3.h>
+// Houdini header - END
+
+// Bifrost headers - START
+#include <BifrostHeaders.h>
+// Bifrost headers - END
+
+#include <utils/BifrostUtils.h>
+
+const char* HoudiniGeo2Bifrost::VOXEL_SCALE_ATTRIBUTE_NAME = "bifrost_voxel_scale";
+const float HoudiniGeo2Bifrost::DEFAULT_VOXEL_SCALE = 0.1f;
+
+float HoudiniGeo2Bifrost::detailVoxelScale(const GEO_Detail* i_gdp)
+{
+	GA_ROHandleF voxel_scale_handle(i_gdp->findFloatTuple(GA_ATTRIB_DETAIL, VOXEL_SCALE_ATTRIBUTE_NAME, 1));
+	if (!voxel_scale_handle.isValid())
+		return DEFAULT_VOXEL_SCALE;
+	float voxel_scale = voxel_scale_handle.get(GA_Offset(0));
+	if (voxel_scale <= 0.0f)
+	{
+		std::cerr << boost::format("HoudiniGeo2Bifrost : ignoring the non positive %1% detail attribute value %2%, using %3%")
+			% VOXEL_SCALE_ATTRIBUTE_NAME % voxel_scale % DEFAULT_VOXEL_SCALE << std::endl;
+		return DEFAULT_VOXEL_SCALE;
+	}
+	return voxel_scale;
+}
+
+HoudiniGeo2Bifrost::HoudiniGeo2Bifrost(const std::string& i_bifrost_filename,
+									   float i_voxel_scale)
+: _bifrost_filename(i_bifrost_filename)
+, _voxel_scale(i_voxel_scale)
 {
 
 }
@@ -9,6 +45,195 @@ HoudiniGeo2Bifrost::~HoudiniGeo2Bifrost()
 {
 
 }
+
+HoudiniGeo2Bifrost::HoudiniAttributeNameToBifrostChannelNameMap HoudiniGeo2Bifrost::initializeAttributeChannelMap()
+{
+	// Reverse of the Bifrost_IOTranslator naming, everything else keeps its Houdini name
+	HoudiniAttributeNameToBifrostChannelNameMap acMap;
+	acMap.insert(std::pair<std::string,std::string>("id","id64"));
+	acMap.insert(std::pair<std::string,std::string>("P","position"));
+	acMap.insert(std::pair<std::string,std::string>("v","velocity"));
+
+	return acMap;
+}
+
+HoudiniGeo2Bifrost::HoudiniAttributeNameToBifrostChannelNameMap HoudiniGeo2Bifrost::_han2bcn_map = HoudiniGeo2Bifrost::initializeAttributeChannelMap();
+
+namespace {
+
+template<typename T>
+bool write_point_channel(Bifrost::API::StateServer& ss,
+						 Bifrost::API::Component& component,
+						 Bifrost::API::DataType data_type,
+						 const std::string& channel_name,
+						 const std::vector<T>& values,
+						 const std::vector<size_t>& order,
+						 const PointTileRangeContainer& tiles)
+{
+	Bifrost::API::Channel channel = ss.createChannel(component, data_type, channel_name.c_str());
+	if (!channel.valid())
+	{
+		std::cerr << boost::format("HoudiniGeo2Bifrost : unable to create channel '%1%'") % channel_name << std::endl;
+		return false;
+	}
+	return set_point_channel_data<T>(channel, values, order, tiles);
+}
+
+}
+
+bool HoudiniGeo2Bifrost::process(const GEO_Detail* i_gdp)
+{
+	GA_Size numPoints = i_gdp->getNumPoints();
+	if (numPoints == 0)
+	{
+		std::cerr << boost::format("No points to write to the Bifrost file \"%1%\"") % _bifrost_filename.c_str()
+				  << std::endl;
+		return false;
+	}
+	GA_Range p_range = i_gdp->getPointRange();
+
+	Bifrost::API::ObjectModel om;
+	Bifrost::API::StateServer ss = om.createStateServer();
+	Bifrost::API::Layout layout = ss.createLayout("HoudiniGeo2Bifrost_layout", _voxel_scale);
+	Bifrost::API::Component component = ss.createComponent(Bifrost::API::PointComponentType,
+														   "HoudiniGeo2Bifrost-particle",
+														   layout);
+	if (!component.valid())
+	{
+		std::cerr << "Unable to create the Bifrost point component" << std::endl;
+		return false;
+	}
+
+	// Bifrost stores positions in voxel space
+	UT_ValArray<UT_Vector3> v3_array;
+	i_gdp->getAttributeAsArray(i_gdp->getP(),p_range,v3_array);
+	const float inv_voxel_scale = 1.0f / _voxel_scale;
+	std::vector<amino::Math::vec3f> voxel_positions(numPoints);
+	for (GA_Size i = 0; i<numPoints;i++)
+	{
+		voxel_positions[i].v[0] = v3_array.array()[i].x() * inv_voxel_scale;
+		voxel_positions[i].v[1] = v3_array.array()[i].y() * inv_voxel_scale;
+		voxel_positions[i].v[2] = v3_array.array()[i].z() * inv_voxel_scale;
+	}
+
+	std::vector<size_t> order;
+	PointTileRangeContainer tiles;
+	if (!build_point_tiles(component,voxel_positions,order,tiles))
+		return false;
+
+	if (!write_point_channel<amino::Math::vec3f>(ss,component,Bifrost::API::FloatV3Type,"position",voxel_positions,order,tiles))
+		return false;
+
+	// All remaining public point attributes
+	for (GA_AttributeDict::iterator it = i_gdp->pointAttribs().begin(GA_SCOPE_PUBLIC); !it.atEnd(); ++it)
+	{
+		const GA_Attribute* attrib = it.attrib();
+		if (attrib == i_gdp->getP())
+			continue;
+
+		std::string attrib_name(attrib->getName());
+		std::string channel_name(attrib_name);
+		HoudiniAttributeNameToBifrostChannelNameMap::const_iterator nameMappingIter = _han2bcn_map.find(attrib_name);
+		if (nameMappingIter != _han2bcn_map.end())
+			channel_name = nameMappingIter->second;
+
+		bool successfully_processed = true;
+		switch (attrib->getStorageClass())
+		{
+		case GA_STORECLASS_FLOAT:
+			{
+				switch (attrib->getTupleSize())
+				{
+				case 1:
+					{
+						UT_ValArray<fpreal32> float_array;
+						i_gdp->getAttributeAsArray(attrib,p_range,float_array);
+						std::vector<float> channel_data_array(float_array.array(),float_array.array() + numPoints);
+						successfully_processed = write_point_channel<float>(ss,component,Bifrost::API::FloatType,channel_name,channel_data_array,order,tiles);
+					}
+					break;
+				case 2:
+					{
+						UT_ValArray<UT_Vector2> v2_array;
+						i_gdp->getAttributeAsArray(attrib,p_range,v2_array);
+						std::vector<amino::Math::vec2f> channel_data_array(numPoints);
+						for (GA_Size i = 0; i<numPoints;i++)
+						{
+							channel_data_array[i].v[0] = v2_array.array()[i].x();
+							channel_data_array[i].v[1] = v2_array.array()[i].y();
+						}
+						successfully_processed = write_point_channel<amino::Math::vec2f>(ss,component,Bifrost::API::FloatV2Type,channel_name,channel_data_array,order,tiles);
+					}
+					break;
+				case 3:
+					{
+						UT_ValArray<UT_Vector3> attrib_v3_array;
+						i_gdp->getAttributeAsArray(attrib,p_range,attrib_v3_array);
+						std::vector<amino::Math::vec3f> channel_data_array(numPoints);
+						for (GA_Size i = 0; i<numPoints;i++)
+						{
+							channel_data_array[i].v[0] = attrib_v3_array.array()[i].x();
+							channel_data_array[i].v[1] = attrib_v3_array.array()[i].y();
+							channel_data_array[i].v[2] = attrib_v3_array.array()[i].z();
+						}
+						successfully_processed = write_point_channel<amino::Math::vec3f>(ss,component,Bifrost::API::FloatV3Type,channel_name,channel_data_array,order,tiles);
+					}
+					break;
+				default:
+					std::cerr << boost::format("HoudiniGeo2Bifrost : skipping float attribute '%1%' of tuple size %2%, only 1 to 3 are supported")
+						% attrib_name % attrib->getTupleSize() << std::endl;
+					break;
+				}
+			}
+			break;
+		case GA_STORECLASS_INT:
+			{
+				if (attrib->getTupleSize() != 1)
+				{
+					std::cerr << boost::format("HoudiniGeo2Bifrost : skipping integer attribute '%1%' of tuple size %2%, only 1 is supported")
+						% attrib_name % attrib->getTupleSize() << std::endl;
+					break;
+				}
+				UT_ValArray<int64> int64_array;
+				i_gdp->getAttributeAsArray(attrib,p_range,int64_array);
+				if (channel_name == "id64")
+				{
+					/*!
+					 * \remark Houdini has no unsigned 64bit integer, the translator
+					 *         reads id64 back as a signed 64bit integer
+					 */
+					std::vector<uint64_t> channel_data_array(int64_array.array(),int64_array.array() + numPoints);
+					successfully_processed = write_point_channel<uint64_t>(ss,component,Bifrost::API::UInt64Type,channel_name,channel_data_array,order,tiles);
+				}
+				else
+				{
+					std::vector<int32_t> channel_data_array(int64_array.array(),int64_array.array() + numPoints);
+					successfully_processed = write_point_channel<int32_t>(ss,component,Bifrost::API::Int32Type,channel_name,channel_data_array,order,tiles);
+				}
+			}
+			break;
+		default:
+			std::cerr << boost::format("HoudiniGeo2Bifrost : skipping attribute '%1%', only float and integer attributes are supported")
+				% attrib_name << std::endl;
+			break;
+		}
+		if (!successfully_processed)
+			return false;
+	}
+
+	Bifrost::API::FileIO fileio = om.createFileIO( _bifrost_filename.c_str() );
+	Bifrost::API::Status status = fileio.save(component, Bifrost::API::BIF::Compression::Level0, 0);
+	if (!status.succeeded())
+	{
+		std::cerr << boost::format("HoudiniGeo2Bifrost : unable to save the Bifrost file \"%1%\"") % _bifrost_filename.c_str()
+				  << std::endl;
+		return false;
+	}
+
+	std::cout << boost::format("HoudiniGeo2Bifrost : wrote %1% points in %2% tiles to \"%3%\"")
+		% numPoints % tiles.size() % _bifrost_filename.c_str() << std::endl;
+	return true;
+}
 // == Emacs ================
 // -------------------------
 // Local variables:
@@ -1,10 +1,41 @@
 #pragma once
 
+#include <string>
+#include <map>
+
+class GEO_Detail;
+
+/*!
+ * \brief Writes the points of a Houdini detail as a Bifrost point component
+ * \note Points are assigned to tiles spatially and each channel is written
+ *       one tile block at a time
+ */
 class HoudiniGeo2Bifrost
 {
+	typedef std::map<std::string,std::string> HoudiniAttributeNameToBifrostChannelNameMap;
+	static HoudiniAttributeNameToBifrostChannelNameMap _han2bcn_map;
+	static HoudiniAttributeNameToBifrostChannelNameMap initializeAttributeChannelMap();
 public:
-	HoudiniGeo2Bifrost();
+	/*! \brief Detail attribute holding the voxel scale of the written layout */
+	static const char* VOXEL_SCALE_ATTRIBUTE_NAME;
+	static const float DEFAULT_VOXEL_SCALE;
+	/*!
+	 * \brief Voxel scale set on the detail by its VOXEL_SCALE_ATTRIBUTE_NAME
+	 *        float attribute, DEFAULT_VOXEL_SCALE when it is missing or not
+	 *        positive
+	 */
+	static float detailVoxelScale(const GEO_Detail* i_gdp);
+	HoudiniGeo2Bifrost(const std::string& i_bifrost_filename,
+					   float i_voxel_scale = DEFAULT_VOXEL_SCALE);
 	virtual ~HoudiniGeo2Bifrost();
+	/*!
+	 * \brief Write the public point attributes, attributes of a type with no
+	 *        Bifrost channel equivalent are skipped with a warning
+	 */
+	virtual bool process(const GEO_Detail* i_gdp);
+private:
+	std::string _bifrost_filename;
+	float _voxel_scale;
 };
 // == Emacs ================
 // -------------------------
@@ -0,0 +1,673 @@
+#include "BifrostFrameLoader.h"
+#include <maya/MGlobal.h>
+#include <utils/BifrostUtils.h>
+
+#include <boost/format.hpp>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <math.h>
+#include <set>
+#include <sys/stat.h>
+
+/*! \brief Decoded frames kept by default, the shape overrides it */
+const size_t DEFAULT_MEMORY_BUDGET = size_t(1024) * 1024 * 1024;
+/*! \brief Bifrost files are I/O bound, more workers only add contention */
+const size_t MAX_WORKER_COUNT = 4;
+
+namespace {
+
+/*!
+ * \brief Voxel channel the preview surface is extracted from, liquids
+ *        store a signed distance, Aero a density
+ */
+struct SurfaceChannel
+{
+	Bifrost::API::Channel channel;
+	bool levelSet;
+	bool inside(float value) const
+	{
+		return levelSet ? value < 0.0f : value > SURFACE_DENSITY_THRESHOLD;
+	}
+	static const float SURFACE_DENSITY_THRESHOLD;
+};
+const float SurfaceChannel::SURFACE_DENSITY_THRESHOLD = 0.1f;
+
+bool findSurfaceChannel(const Bifrost::API::Component& component, SurfaceChannel& o_surface)
+{
+	const char* levelSetNames[] = {"distance", 0};
+	const char* densityNames[] = {"density", "smoke", 0};
+	const char** names[] = {levelSetNames, densityNames};
+	for (int n=0;n<2;n++)
+	{
+		for (const char** name=names[n];*name;name++)
+		{
+			int channelIndex = findChannelIndexViaName(component,*name);
+			if (channelIndex<0)
+				continue;
+			Bifrost::API::Channel channel = component.channels()[channelIndex];
+			if (channel.dataType() != Bifrost::API::FloatType)
+				continue;
+			o_surface.channel = channel;
+			o_surface.levelSet = (n == 0);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*!
+ * \brief Union of the bounds of every allocated tile of a voxel component,
+ *        parents of partly refined regions hold voxels too. Only the tile
+ *        tree is visited, no voxel data is read
+ */
+bool voxelComponentBounds(const Bifrost::API::Layout& layout, MBoundingBox& o_bbox)
+{
+	Bifrost::API::TileAccessor accessor = layout.tileAccessor();
+	const float voxel_scale = layout.voxelScale();
+	bool found = false;
+	size_t depthCount = layout.depthCount();
+	for ( size_t d=0; d<depthCount; d++ ) {
+		size_t tcount = layout.tileCount(d);
+		for ( size_t t=0; t<tcount; t++ ) {
+			const Bifrost::API::TileInfo info = accessor.tile(Bifrost::API::TreeIndex(t,d)).info();
+			amino::Math::vec3f tileMin, tileMax;
+			tile_world_bounds(info,voxel_scale,tileMin,tileMax);
+			o_bbox.expand(MPoint(tileMin[0],tileMin[1],tileMin[2]));
+			o_bbox.expand(MPoint(tileMax[0],tileMax[1],tileMax[2]));
+			found = true;
+		}
+	}
+	return found;
+}
+
+/*!
+ * \brief Append the outward facing quad of voxel side (axis, side) as two
+ *        triangles with a flat normal
+ */
+void appendVoxelFace(const float i_voxelMin[3], float i_voxelSize, int i_axis, int i_side,
+					 BodyMeshData& io_mesh)
+{
+	const int u = (i_axis + 1) % 3;
+	const int v = (i_axis + 2) % 3;
+	// Counter clockwise seen from outside, reversed for the negative side
+	const float corners[4][2] = {{0,0},{1,0},{1,1},{0,1}};
+	const unsigned int base = static_cast<unsigned int>(io_mesh._meshPositions.size() / 3);
+	for (int c=0;c<4;c++)
+	{
+		const int corner = (i_side > 0) ? c : 3 - c;
+		float position[3];
+		position[i_axis] = i_voxelMin[i_axis] + ((i_side > 0) ? i_voxelSize : 0.0f);
+		position[u] = i_voxelMin[u] + corners[corner][0] * i_voxelSize;
+		position[v] = i_voxelMin[v] + corners[corner][1] * i_voxelSize;
+		for (int a=0;a<3;a++)
+		{
+			io_mesh._meshPositions.push_back(position[a]);
+			io_mesh._meshNormals.push_back(a == i_axis ? static_cast<float>(i_side) : 0.0f);
+		}
+		io_mesh._meshBBox.expand(MPoint(position[0],position[1],position[2]));
+	}
+	const unsigned int triangles[6] = {0,1,2,0,2,3};
+	for (int i=0;i<6;i++)
+		io_mesh._meshGLIndices.push_back(base + triangles[i]);
+}
+
+/*!
+ * \brief Blocky preview surface made of the voxel faces separating inside
+ *        from outside voxels of the leaf tiles
+ *
+ * Neighbours across a tile border are looked up in the adjacent tile of
+ * the same depth, a missing tile counts as outside.
+ */
+bool extractPreviewSurface(const Bifrost::API::Layout& layout,
+						   const SurfaceChannel& surface,
+						   const std::atomic<bool>& i_cancel,
+						   BodyMeshData& o_mesh)
+{
+	Bifrost::API::TileAccessor accessor = layout.tileAccessor();
+	const float voxel_scale = layout.voxelScale();
+	const Bifrost::API::Channel& channel = surface.channel;
+	size_t depthCount = layout.depthCount();
+	for ( size_t d=0; d<depthCount; d++ ) {
+		size_t tcount = layout.tileCount(d);
+		for ( size_t t=0; t<tcount; t++ ) {
+			if (i_cancel)
+				return false;
+			Bifrost::API::TreeIndex tindex(t,d);
+			if ( !channel.elementCount( tindex ) ) {
+				// nothing there
+				continue;
+			}
+			const Bifrost::API::TileInfo info = accessor.tile(tindex).info();
+			if (info.hasChildren)
+				continue;
+			const int tile_width = static_cast<int>(info.dimInfo.tileWidth);
+			const int voxel_width = static_cast<int>(info.dimInfo.voxelWidth);
+			const Bifrost::API::TileData<float>& tile_data = channel.tileData<float>( tindex );
+			if (tile_data.count() < size_t(tile_width * tile_width * tile_width))
+				continue;
+			const float voxelSize = voxel_width * voxel_scale;
+			const int tileOrigin[3] = {info.i, info.j, info.k};
+			for (int k=0; k<tile_width; k++ ) {
+				for (int j=0; j<tile_width; j++ ) {
+					for (int i=0; i<tile_width; i++ ) {
+						if (!surface.inside(tile_data[i + tile_width * (j + tile_width * k)]))
+							continue;
+						const int voxel[3] = {i, j, k};
+						float voxelMin[3];
+						for (int a=0;a<3;a++)
+							voxelMin[a] = (tileOrigin[a] + voxel[a] * voxel_width) * voxel_scale;
+						for (int axis=0;axis<3;axis++) {
+							for (int side=-1;side<=1;side+=2) {
+								int neighbour[3] = {i, j, k};
+								neighbour[axis] += side;
+								bool neighbourInside = false;
+								if (neighbour[axis] >= 0 && neighbour[axis] < tile_width)
+								{
+									neighbourInside = surface.inside(tile_data[neighbour[0] + tile_width * (neighbour[1] + tile_width * neighbour[2])]);
+								}
+								else
+								{
+									int neighbourTile[3] = {tileOrigin[0], tileOrigin[1], tileOrigin[2]};
+									neighbourTile[axis] += side * tile_width * voxel_width;
+									Bifrost::API::TreeIndex nindex = accessor.index(neighbourTile[0],neighbourTile[1],neighbourTile[2],d);
+									if (nindex.valid() && channel.elementCount( nindex ))
+									{
+										const Bifrost::API::TileData<float>& neighbour_data = channel.tileData<float>( nindex );
+										neighbour[axis] = (side > 0) ? 0 : tile_width - 1;
+										size_t index = neighbour[0] + tile_width * (neighbour[1] + tile_width * neighbour[2]);
+										neighbourInside = index < neighbour_data.count() && surface.inside(neighbour_data[index]);
+									}
+								}
+								if (!neighbourInside)
+									appendVoxelFace(voxelMin,voxelSize,axis,side,o_mesh);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	o_mesh._hasMeshVertexNormal = !o_mesh._meshNormals.empty();
+	return true;
+}
+
+} // namespace
+
+BifrostFrameData::BifrostFrameData()
+: _particleBBox(MBoundingBox(MPoint(-1,-1,-1),MPoint(1,1,1)))
+, _hasParticleColor(false)
+, _hasParticleData(false)
+, _hasTileBoxes(false)
+, _hasBBox(false)
+, _allPoints(false)
+, _hasParticleIds(false)
+, _hasPointTiles(false)
+{
+}
+
+size_t BifrostFrameData::memoryUsage() const
+{
+	size_t meshUsage = 0;
+	for (size_t i=0;i<_bm.size();i++)
+		meshUsage += (_bm[i]._meshPositions.capacity()
+					  + _bm[i]._meshColors.capacity()
+					  + _bm[i]._meshNormals.capacity()) * sizeof(float)
+			+ _bm[i]._meshGLIndices.capacity() * sizeof(unsigned int);
+	return sizeof(BifrostFrameData)
+		+ _particlePositions.capacity() * sizeof(float)
+		+ _particleColors.capacity() * sizeof(float)
+		+ _particleIds.capacity() * sizeof(uint64_t)
+		+ _tileBoxes.capacity() * sizeof(float)
+		+ _pointTiles.capacity() * sizeof(BifrostPointTile)
+		+ meshUsage;
+}
+
+BifrostFrameLoader::BifrostFrameLoader()
+: _currentPending(false)
+, _stop(false)
+, _publishCommand("refresh")
+, _memoryUsage(0)
+, _memoryBudget(DEFAULT_MEMORY_BUDGET)
+{
+}
+
+BifrostFrameLoader::~BifrostFrameLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+		for (size_t i=0;i<_workers.size();i++)
+			_workers[i]->_cancel = true;
+	}
+	_condition.notify_all();
+	for (size_t i=0;i<_workers.size();i++)
+		if (_workers[i]->_thread.joinable())
+			_workers[i]->_thread.join();
+}
+
+void BifrostFrameLoader::setMemoryBudget(size_t i_bytes)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_memoryBudget = i_bytes;
+	evict();
+}
+
+void BifrostFrameLoader::request(const std::string& i_filename,
+								 const StringContainer& i_prefetch)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_current = i_filename;
+		_queue.clear();
+
+		// Touch in reverse priority order so that the current frame ends up
+		// the most recently used and the frames played past are evicted first
+		std::set<std::string> wanted;
+		wanted.insert(i_filename);
+		size_t prefetchCount = i_prefetch.size();
+		if (_latest)
+		{
+			// Do not prefetch more than the budget can keep around
+			size_t frameSize = std::max<size_t>(_latest->memoryUsage(),1);
+			size_t budgetFrames = _memoryBudget / frameSize;
+			prefetchCount = std::min(prefetchCount, budgetFrames > 1 ? budgetFrames - 1 : 0);
+		}
+		for (size_t i=prefetchCount;i>0;i--)
+		{
+			const std::string& filename = i_prefetch[i-1];
+			wanted.insert(filename);
+			touch(filename);
+		}
+
+		BifrostFrameDataConstPtr frame = touch(i_filename);
+		_currentPending = !frame;
+		if (frame)
+			_latest = frame;
+		else if (!isDecoding(i_filename))
+			_queue.push_back(i_filename);
+
+		for (size_t i=0;i<prefetchCount;i++)
+		{
+			const std::string& filename = i_prefetch[i];
+			if (_cacheIndex.find(filename) == _cacheIndex.end() && !isDecoding(filename))
+				_queue.push_back(filename);
+		}
+
+		// Whatever is being decoded and no longer wanted is now stale
+		for (size_t i=0;i<_workers.size();i++)
+			if (!_workers[i]->_filename.empty() && wanted.find(_workers[i]->_filename) == wanted.end())
+				_workers[i]->_cancel = true;
+
+		// The workers are only started once the shape is actually used
+		if (_workers.empty())
+		{
+			size_t workerCount = std::max<size_t>(1,std::min<size_t>(std::thread::hardware_concurrency()/2,MAX_WORKER_COUNT));
+			for (size_t i=0;i<workerCount;i++)
+			{
+				_workers.push_back(WorkerPtr(new Worker));
+				_workers.back()->_thread = std::thread(&BifrostFrameLoader::run, this, std::ref(*_workers.back()));
+			}
+		}
+	}
+	_condition.notify_all();
+}
+
+bool BifrostFrameLoader::setDisplaySettings(const BifrostDisplaySettings& i_settings)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_settings == i_settings)
+		return false;
+	_settings = i_settings;
+	_cache.clear();
+	_cacheIndex.clear();
+	_memoryUsage = 0;
+	_queue.clear();
+	for (size_t i=0;i<_workers.size();i++)
+		if (!_workers[i]->_filename.empty())
+			_workers[i]->_cancel = true;
+	return true;
+}
+
+void BifrostFrameLoader::setPublishCommand(const std::string& i_command)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_publishCommand = i_command;
+}
+
+BifrostFrameDataConstPtr BifrostFrameLoader::latest() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _latest;
+}
+
+bool BifrostFrameLoader::busy() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _currentPending;
+}
+
+BifrostFrameDataConstPtr BifrostFrameLoader::load(const std::string& i_filename)
+{
+	BifrostDisplaySettings settings;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		BifrostFrameDataConstPtr frame = touch(i_filename);
+		if (frame && frame->_allPoints && frame->_hasPointTiles)
+			return frame;
+		settings = _settings;
+	}
+
+	// Keep the preview surface setting so the result can go in the cache
+	settings._pointBudget = 0;
+	settings._tileBoxes = false;
+	std::shared_ptr<BifrostFrameData> frame(new BifrostFrameData);
+	std::atomic<bool> cancel(false);
+	if (!decode(i_filename, settings, true, cancel, *frame))
+		return BifrostFrameDataConstPtr();
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		const size_t pointCount = frame->_particlePositions.size() / 3;
+		if (!_settings._tileBoxes
+			&& _settings._previewSurface == settings._previewSurface
+			&& (_settings._pointBudget == 0 || pointCount <= _settings._pointBudget))
+			insert(frame);
+	}
+	return frame;
+}
+
+void BifrostFrameLoader::run(Worker& worker)
+{
+	while (true)
+	{
+		std::string filename;
+		bool isCurrent = false;
+		BifrostDisplaySettings settings;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (!_stop && _queue.empty())
+				_condition.wait(lock);
+			if (_stop)
+				return;
+			filename = _queue.front();
+			_queue.pop_front();
+			worker._filename = filename;
+			worker._cancel = false;
+			isCurrent = (filename == _current);
+			settings = _settings;
+		}
+
+		std::shared_ptr<BifrostFrameData> frame(new BifrostFrameData);
+		bool decoded = false;
+		// Prefetching past the end of a sequence is expected, stay quiet
+		struct stat fileStat;
+		if (isCurrent || stat(filename.c_str(),&fileStat) == 0)
+			decoded = decode(filename, settings, false, worker._cancel, *frame);
+
+		bool published = false;
+		bool requeued = false;
+		std::string publishCommand;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			worker._filename.clear();
+			if (worker._cancel && filename == _current)
+			{
+				// Cancelled then requested again before the decode noticed
+				_queue.push_front(filename);
+				requeued = true;
+			}
+			else
+			{
+				if (decoded && !worker._cancel)
+				{
+					insert(frame);
+					if (filename == _current)
+					{
+						_latest = frame;
+						published = true;
+						publishCommand = _publishCommand;
+					}
+				}
+				if (filename == _current)
+					_currentPending = false;
+			}
+		}
+		if (requeued)
+			_condition.notify_one();
+		if (published)
+			MGlobal::executeCommandOnIdle(publishCommand.c_str());
+	}
+}
+
+BifrostFrameDataConstPtr BifrostFrameLoader::touch(const std::string& i_filename)
+{
+	CacheIndex::iterator iter = _cacheIndex.find(i_filename);
+	if (iter == _cacheIndex.end())
+		return BifrostFrameDataConstPtr();
+	_cache.splice(_cache.begin(), _cache, iter->second);
+	return iter->second->second;
+}
+
+void BifrostFrameLoader::insert(const BifrostFrameDataConstPtr& i_frame)
+{
+	CacheIndex::iterator iter = _cacheIndex.find(i_frame->_filename);
+	if (iter != _cacheIndex.end())
+	{
+		_memoryUsage -= iter->second->second->memoryUsage();
+		_cache.erase(iter->second);
+		_cacheIndex.erase(iter);
+	}
+	_cache.push_front(CacheEntry(i_frame->_filename,i_frame));
+	_cacheIndex[i_frame->_filename] = _cache.begin();
+	_memoryUsage += i_frame->memoryUsage();
+	evict();
+}
+
+void BifrostFrameLoader::evict()
+{
+	CacheContainer::iterator iter = _cache.end();
+	while (_memoryUsage > _memoryBudget && iter != _cache.begin())
+	{
+		--iter;
+		// The current frame is kept even if it alone exceeds the budget
+		if (iter->first == _current)
+			continue;
+		_memoryUsage -= iter->second->memoryUsage();
+		_cacheIndex.erase(iter->first);
+		iter = _cache.erase(iter);
+	}
+}
+
+bool BifrostFrameLoader::isDecoding(const std::string& i_filename) const
+{
+	for (size_t i=0;i<_workers.size();i++)
+		if (_workers[i]->_filename == i_filename)
+			return true;
+	return false;
+}
+
+bool BifrostFrameLoader::decode(const std::string& i_filename,
+								const BifrostDisplaySettings& i_settings,
+								bool i_pointTiles,
+								const std::atomic<bool>& i_cancel,
+								BifrostFrameData& o_frame)
+{
+	o_frame._filename = i_filename;
+	o_frame._particlePositions.clear();
+	o_frame._tileBoxes.clear();
+	o_frame._pointTiles.clear();
+	o_frame._bm.clear();
+	o_frame._bf.clear();
+
+	Bifrost::API::String biffile = i_filename.c_str();
+
+	Bifrost::API::ObjectModel om;
+	Bifrost::API::FileIO fileio = om.createFileIO( biffile );
+	Bifrost::API::StateServer ss = fileio.load( );
+
+	if ( !ss.valid() ) {
+		std::cerr << boost::format("Unable to load the content of the Bifrost file \"%1%\"") % biffile.c_str()
+				  << std::endl;
+		return false;
+	}
+
+	// The budget is shared by all the point components of the file
+	size_t numComponents = ss.components().count();
+	size_t totalPointCount = 0;
+	for (size_t componentIndex=0;componentIndex<numComponents;componentIndex++)
+	{
+		Bifrost::API::Component component = ss.components()[componentIndex];
+		if ( component.type() == Bifrost::API::PointComponentType )
+			totalPointCount += component.elementCount();
+	}
+	float fraction = 1.0f;
+	if (i_settings._pointBudget > 0 && totalPointCount > i_settings._pointBudget)
+		fraction = static_cast<float>(i_settings._pointBudget) / totalPointCount;
+
+	MBoundingBox particleBBox;
+	std::vector<size_t> lodIndices;
+	for (size_t componentIndex=0;componentIndex<numComponents;componentIndex++)
+	{
+		Bifrost::API::Component component = ss.components()[componentIndex];
+		if ( component.type() == Bifrost::API::VoxelComponentType )
+		{
+			BodyFieldData field;
+			if (voxelComponentBounds(component.layout(),field._fieldBBox))
+				o_frame._bf.push_back(field);
+			SurfaceChannel surface;
+			if (i_settings._previewSurface && findSurfaceChannel(component,surface))
+			{
+				BodyMeshData mesh;
+				if (!extractPreviewSurface(component.layout(),surface,i_cancel,mesh))
+					return false;
+				if (!mesh._meshPositions.empty())
+					o_frame._bm.push_back(mesh);
+			}
+			continue;
+		}
+		if ( component.type() != Bifrost::API::PointComponentType )
+			continue;
+
+		int positionChannelIndex = findChannelIndexViaName(component,"position");
+		if (positionChannelIndex<0)
+			continue;
+		Bifrost::API::Channel position_ch = component.channels()[positionChannelIndex];
+		if (position_ch.dataType() != Bifrost::API::FloatV3Type)
+			continue;
+		Bifrost::API::Channel id_ch;
+		int idChannelIndex = findChannelIndexViaName(component,"id64");
+		if (idChannelIndex>=0)
+			id_ch = component.channels()[idChannelIndex];
+		// Ids let the render motion samples of different frames be matched
+		const bool keepIds = fraction >= 1.0f && !i_settings._tileBoxes
+			&& id_ch.valid() && id_ch.dataType() == Bifrost::API::UInt64Type;
+		Bifrost::API::Channel velocity_ch;
+		int velocityChannelIndex = findChannelIndexViaName(component,"velocity");
+		if (velocityChannelIndex>=0)
+			velocity_ch = component.channels()[velocityChannelIndex];
+		const bool hasVelocity = i_pointTiles && velocity_ch.valid() && velocity_ch.dataType() == Bifrost::API::FloatV3Type;
+
+		Bifrost::API::Layout layout = component.layout();
+		Bifrost::API::TileAccessor accessor = layout.tileAccessor();
+		float voxel_scale = layout.voxelScale();
+		if (!i_settings._tileBoxes)
+			o_frame._particlePositions.reserve(o_frame._particlePositions.size() + 3 * static_cast<size_t>(component.elementCount() * fraction));
+		size_t depthCount = layout.depthCount();
+		for ( size_t d=0; d<depthCount; d++ ) {
+			size_t tcount = layout.tileCount(d);
+			for ( size_t t=0; t<tcount; t++ ) {
+				if (i_cancel)
+					return false;
+				Bifrost::API::TreeIndex tindex(t,d);
+				if ( !position_ch.elementCount( tindex ) ) {
+					// nothing there
+					continue;
+				}
+				amino::Math::vec3f tileMin, tileMax;
+				tile_world_bounds(accessor.tile(tindex).info(),voxel_scale,tileMin,tileMax);
+				if (i_pointTiles)
+				{
+					BifrostPointTile pointTile;
+					pointTile._componentIndex = componentIndex;
+					pointTile._tileDepth = d;
+					pointTile._tileIndex = t;
+					for (int c=0;c<3;c++)
+					{
+						pointTile._bounds[c] = tileMin[c];
+						pointTile._bounds[3+c] = tileMax[c];
+					}
+					float maxSpeed = 0.0f;
+					if (hasVelocity)
+					{
+						const Bifrost::API::TileData<amino::Math::vec3f>& velocity_tile_data = velocity_ch.tileData<amino::Math::vec3f>( tindex );
+						for (size_t i=0;i<velocity_tile_data.count();i++)
+						{
+							const amino::Math::vec3f& v = velocity_tile_data[i];
+							maxSpeed = std::max(maxSpeed, v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+						}
+					}
+					pointTile._maxSpeed = sqrtf(maxSpeed);
+					o_frame._pointTiles.push_back(pointTile);
+				}
+				if (i_settings._tileBoxes)
+				{
+					for (int c=0;c<3;c++)
+						o_frame._tileBoxes.push_back(tileMin[c]);
+					for (int c=0;c<3;c++)
+						o_frame._tileBoxes.push_back(tileMax[c]);
+					particleBBox.expand(MPoint(tileMin[0],tileMin[1],tileMin[2]));
+					particleBBox.expand(MPoint(tileMax[0],tileMax[1],tileMax[2]));
+					continue;
+				}
+				const Bifrost::API::TileData<amino::Math::vec3f>& position_tile_data = position_ch.tileData<amino::Math::vec3f>( tindex );
+				const size_t pointCount = position_tile_data.count();
+				// Stable subset of the tile points, empty when every point is kept
+				select_lod_points(id_ch,tindex,pointCount,fraction,lodIndices);
+				const bool decimated = fraction < 1.0f;
+				const size_t keptCount = decimated ? lodIndices.size() : pointCount;
+				for (size_t n=0; n<keptCount; n++ ) {
+					const size_t i = decimated ? lodIndices[n] : n;
+					float x = position_tile_data[i][0] * voxel_scale;
+					float y = position_tile_data[i][1] * voxel_scale;
+					float z = position_tile_data[i][2] * voxel_scale;
+					o_frame._particlePositions.push_back(x);
+					o_frame._particlePositions.push_back(y);
+					o_frame._particlePositions.push_back(z);
+					particleBBox.expand(MPoint(x,y,z));
+				}
+				if (keepIds)
+				{
+					const Bifrost::API::TileData<uint64_t>& id_tile_data = id_ch.tileData<uint64_t>( tindex );
+					for (size_t i=0; i<pointCount; i++)
+						o_frame._particleIds.push_back(id_tile_data[i]);
+				}
+			}
+		}
+	}
+
+	o_frame._hasParticleData = !o_frame._particlePositions.empty();
+	o_frame._hasTileBoxes = !o_frame._tileBoxes.empty();
+	o_frame._allPoints = !i_settings._tileBoxes && fraction >= 1.0f;
+	o_frame._hasPointTiles = i_pointTiles;
+	o_frame._hasParticleIds = o_frame._allPoints && o_frame._hasParticleData
+		&& o_frame._particleIds.size() * 3 == o_frame._particlePositions.size();
+	if (!o_frame._hasParticleIds)
+		BifrostFrameData::IdVector().swap(o_frame._particleIds);
+	if (o_frame._hasParticleData || o_frame._hasTileBoxes)
+		o_frame._particleBBox = particleBBox;
+
+	// Shape bounds, done once here so that boundingBox() is a lookup
+	MBoundingBox bbox;
+	for (size_t i=0;i<o_frame._bm.size();i++)
+		bbox.expand(o_frame._bm[i]._meshBBox);
+	for (size_t i=0;i<o_frame._bf.size();i++)
+		bbox.expand(o_frame._bf[i]._fieldBBox);
+	if (o_frame._hasParticleData || o_frame._hasTileBoxes)
+		bbox.expand(o_frame._particleBBox);
+	o_frame._hasBBox = !o_frame._bm.empty() || !o_frame._bf.empty()
+		|| o_frame._hasParticleData || o_frame._hasTileBoxes;
+	if (o_frame._hasBBox)
+		o_frame._bbox = bbox;
+	return true;
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <maya/MBoundingBox.h>
+
+#include <atomic>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+ * \brief How much of a Bifrost file is decoded for display
+ */
+struct BifrostDisplaySettings
+{
+	BifrostDisplaySettings() : _pointBudget(0), _tileBoxes(false), _previewSurface(false) {}
+	bool operator==(const BifrostDisplaySettings& other) const
+	{
+		return _pointBudget == other._pointBudget
+			&& _tileBoxes == other._tileBoxes
+			&& _previewSurface == other._previewSurface;
+	}
+	/*! \brief Maximum number of points kept per frame, 0 keeps them all */
+	size_t _pointBudget;
+	/*! \brief Only gather the bounds of the occupied tiles, no point is read */
+	bool _tileBoxes;
+	/*! \brief Extract a blocky surface from the leaf tiles of voxel components */
+	bool _previewSurface;
+};
+
+/*!
+ * \brief Preview surface extracted from a voxel component
+ */
+struct BodyMeshData
+{
+	typedef std::vector<float> FloatVector;
+	typedef std::vector<unsigned int> UIntVector;
+	BodyMeshData() : _hasMeshVertexColor(false), _hasMeshVertexNormal(false) {}
+	MBoundingBox _meshBBox;
+	FloatVector _meshPositions;
+	FloatVector _meshColors;
+	FloatVector _meshNormals;
+	UIntVector _meshGLIndices;
+	bool _hasMeshVertexColor;
+	bool _hasMeshVertexNormal;
+};
+typedef std::vector<BodyMeshData> BodyMeshDataCollection;
+
+/*!
+ * \brief Extent of a voxel component
+ */
+struct BodyFieldData
+{
+	MBoundingBox _fieldBBox;
+};
+typedef std::vector<BodyFieldData> BodyFieldDataCollection;
+
+/*!
+ * \brief Occupied tile of a point component, kept with the frame so the
+ *        render bounds need no access to the file
+ */
+struct BifrostPointTile
+{
+	size_t _componentIndex;
+	size_t _tileDepth;
+	size_t _tileIndex;
+	/*! \brief World min and max corners of the tile */
+	float _bounds[6];
+	/*! \brief Fastest point of the tile, 0 without a velocity channel */
+	float _maxSpeed;
+};
+
+/*!
+ * \brief Display ready content of a Bifrost file
+ * \note Immutable once published by the loader so that it can be shared
+ *       with the drawing code without locking
+ */
+struct BifrostFrameData
+{
+	typedef std::vector<float> FloatVector;
+	typedef std::vector<uint64_t> IdVector;
+	BifrostFrameData();
+	/*! \brief Approximate heap usage, used for the cache memory budget */
+	size_t memoryUsage() const;
+	std::string _filename;
+	FloatVector _particlePositions;
+	FloatVector _particleColors;
+	/*! \brief id64 of each point, only kept when every point was decoded */
+	IdVector _particleIds;
+	/*! \brief Min and max corners of the occupied tiles, 6 floats per tile */
+	FloatVector _tileBoxes;
+	/*! \brief Every occupied point tile, only recorded by load() for rendering */
+	std::vector<BifrostPointTile> _pointTiles;
+	BodyMeshDataCollection _bm;
+	BodyFieldDataCollection _bf;
+	MBoundingBox _particleBBox;
+	/*! \brief Union of the mesh, field and particle bounds */
+	MBoundingBox _bbox;
+	bool _hasParticleColor;
+	bool _hasParticleData;
+	bool _hasTileBoxes;
+	bool _hasBBox;
+	/*! \brief Every point of the file was decoded, usable for rendering */
+	bool _allPoints;
+	bool _hasParticleIds;
+	bool _hasPointTiles;
+};
+typedef std::shared_ptr<const BifrostFrameData> BifrostFrameDataConstPtr;
+
+/*!
+ * \brief Decodes Bifrost files on worker threads so Maya's main thread
+ *        never waits on file I/O, and keeps the decoded frames in a least
+ *        recently used cache bounded by a memory budget
+ *
+ * Each request names the current frame and the frames to prefetch, in
+ * priority order. The current frame is decoded first, the prefetched ones
+ * by the remaining workers. Decodes of frames which are no longer wanted
+ * are cancelled at the next tile boundary (the Bifrost file read itself
+ * cannot be interrupted, its result is discarded). When the current frame
+ * completes it is published with latest() and the publish command, a
+ * viewport refresh by default, is queued on Maya's idle loop.
+ */
+class BifrostFrameLoader
+{
+public:
+	typedef std::vector<std::string> StringContainer;
+
+	BifrostFrameLoader();
+	~BifrostFrameLoader();
+
+	/*! \brief Memory allowed for decoded frames, in bytes */
+	void setMemoryBudget(size_t i_bytes);
+	/*!
+	 * \brief Make i_filename the current frame and queue the frames of
+	 *        i_prefetch not yet cached, replacing any earlier request
+	 */
+	void request(const std::string& i_filename,
+				 const StringContainer& i_prefetch = StringContainer());
+	/*!
+	 * \brief Change what gets decoded, the cached frames are dropped and the
+	 *        decodes in flight cancelled when the settings differ
+	 * \return true if the settings changed, the current frame should then be
+	 *         requested again
+	 */
+	bool setDisplaySettings(const BifrostDisplaySettings& i_settings);
+	/*!
+	 * \brief MEL command queued on the idle loop when a current frame
+	 *        completes, "refresh" by default
+	 */
+	void setPublishCommand(const std::string& i_command);
+	/*! \brief Last completed current frame, null until the first one completes */
+	BifrostFrameDataConstPtr latest() const;
+	/*! \brief Is the current frame still being decoded */
+	bool busy() const;
+	/*!
+	 * \brief Frame of i_filename with all its points, for rendering
+	 *
+	 * A cached frame is returned when the display settings kept all its
+	 * points, otherwise the file is decoded on the calling thread and the
+	 * result cached if it is also what the viewport would display.
+	 * \return null if the file could not be decoded
+	 */
+	BifrostFrameDataConstPtr load(const std::string& i_filename);
+
+	/*!
+	 * \brief Decode the point and voxel components of a Bifrost file
+	 *
+	 * With a point budget every tile keeps the same fraction of its points,
+	 * chosen by hashing the id64 channel (the point index without it) so the
+	 * displayed subset does not flicker from frame to frame. Voxel components
+	 * only contribute the bounds of their tiles unless a preview surface is
+	 * asked for. The velocity channel is only read when i_pointTiles
+	 * asks for the render bounds of the point tiles.
+	 * \return false on failure or when i_cancel becomes true
+	 */
+	static bool decode(const std::string& i_filename,
+					   const BifrostDisplaySettings& i_settings,
+					   bool i_pointTiles,
+					   const std::atomic<bool>& i_cancel,
+					   BifrostFrameData& o_frame);
+private:
+	struct Worker
+	{
+		Worker() : _cancel(false) {}
+		std::thread _thread;
+		std::atomic<bool> _cancel;
+		/*! \brief File being decoded, empty when idle */
+		std::string _filename;
+	};
+	typedef std::unique_ptr<Worker> WorkerPtr;
+	typedef std::vector<WorkerPtr> WorkerContainer;
+	typedef std::pair<std::string,BifrostFrameDataConstPtr> CacheEntry;
+	typedef std::list<CacheEntry> CacheContainer;
+	typedef std::map<std::string,CacheContainer::iterator> CacheIndex;
+
+	void run(Worker& worker);
+	/*! \brief Mark as most recently used, return null if not cached */
+	BifrostFrameDataConstPtr touch(const std::string& i_filename);
+	void insert(const BifrostFrameDataConstPtr& i_frame);
+	/*! \brief Drop least recently used frames until within budget */
+	void evict();
+	bool isDecoding(const std::string& i_filename) const;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _condition;
+	WorkerContainer _workers;
+	std::deque<std::string> _queue;
+	std::string _current;
+	bool _currentPending;
+	bool _stop;
+	std::string _publishCommand;
+	BifrostDisplaySettings _settings;
+	BifrostFrameDataConstPtr _latest;
+	CacheContainer _cache;
+	CacheIndex _cacheIndex;
+	size_t _memoryUsage;
+	size_t _memoryBudget;
+};
+// == Emacs ================
+// -------------------------
+// Local variables:
+// tab-width: 4
+// indent-tabs-mode: t
+// c-basic-offset: 4
+// end:
+//
+// == vi ===================
+// -------------------------
+// Format block
+// ex:ts=4:sw=4:expandtab
+// -------------------------
@@ -0,0 +1,284 @@
+#include "BifrostGeometryOverride.h"
+#include "BifrostSurfaceShape.h"
+#include <maya/MFnDependencyNode.h>
+#include <maya/MDagPath.h>
+#include <maya/MHWGeometry.h>
+#include <maya/MHWGeometryUtilities.h>
+#include <maya/MShaderManager.h>
+#include <maya/MViewport2Renderer.h>
+
+#include <string.h>
+
+const char* BifrostGeometryOverride::drawDbClassification = "drawdb/geometry/BifrostSurfaceShape";
+const char* BifrostGeometryOverride::drawRegistrantId = "BifrostSurfaceShapeOverride";
+
+static const MString POINTS_RENDER_ITEM_NAME("BifrostParticlePoints");
+static const MString TILE_BOXES_RENDER_ITEM_NAME("BifrostTileBoxes");
+/*! \brief Corner pairs of the 12 edges of a box, corner bit 0/1/2 is max x/y/z */
+static const unsigned int BOX_EDGE_CORNERS[24] = {
+	0,1, 2,3, 4,5, 6,7,
+	0,2, 1,3, 4,6, 5,7,
+	0,4, 1,5, 2,6, 3,7 };
+static const float POINT_SIZE[] = {2.0f, 2.0f};
+
+MHWRender::MPxGeometryOverride* BifrostGeometryOverride::creator(const MObject& obj)
+{
+	return new BifrostGeometryOverride(obj);
+}
+
+BifrostGeometryOverride::BifrostGeometryOverride(const MObject& obj)
+: MHWRender::MPxGeometryOverride(obj)
+, _shape(0)
+{
+	MStatus status;
+	MFnDependencyNode node(obj, &status);
+	if (status)
+		_shape = dynamic_cast<BifrostSurfaceShape*>(node.userNode());
+}
+
+BifrostGeometryOverride::~BifrostGeometryOverride()
+{
+}
+
+MHWRender::DrawAPI BifrostGeometryOverride::supportedDrawAPIs() const
+{
+	// Stock shaders only, available on every device
+	return MHWRender::kAllDevices;
+}
+
+void BifrostGeometryOverride::updateDG()
+{
+	_frame = _shape ? _shape->latestFrame() : BifrostFrameDataConstPtr();
+}
+
+bool BifrostGeometryOverride::requiresGeometryUpdate() const
+{
+	// Keep the resident buffers while the loader publishes the same frame
+	return !_frame || _populatedFrame.lock() != _frame;
+}
+
+void BifrostGeometryOverride::updateRenderItems(const MDagPath& path,
+												MHWRender::MRenderItemList& list)
+{
+	MHWRender::MRenderer* renderer = MHWRender::MRenderer::theRenderer();
+	if (!renderer)
+		return;
+	const MHWRender::MShaderManager* shaderManager = renderer->getShaderManager();
+	if (!shaderManager)
+		return;
+
+	MHWRender::MRenderItem* pointsItem = 0;
+	int index = list.indexOf(POINTS_RENDER_ITEM_NAME);
+	if (index < 0)
+	{
+		pointsItem = MHWRender::MRenderItem::Create(POINTS_RENDER_ITEM_NAME,
+													MHWRender::MRenderItem::DecorationItem,
+													MHWRender::MGeometry::kPoints);
+		pointsItem->setDrawMode(MHWRender::MGeometry::kAll);
+		pointsItem->depthPriority(MHWRender::MRenderItem::sDormantPointDepthPriority);
+		list.append(pointsItem);
+	}
+	else
+	{
+		pointsItem = list.itemAt(index);
+	}
+
+	MHWRender::MRenderItem* tileBoxesItem = 0;
+	index = list.indexOf(TILE_BOXES_RENDER_ITEM_NAME);
+	if (index < 0)
+	{
+		tileBoxesItem = MHWRender::MRenderItem::Create(TILE_BOXES_RENDER_ITEM_NAME,
+													   MHWRender::MRenderItem::DecorationItem,
+													   MHWRender::MGeometry::kLines);
+		tileBoxesItem->setDrawMode(MHWRender::MGeometry::kAll);
+		tileBoxesItem->depthPriority(MHWRender::MRenderItem::sDormantWireDepthPriority);
+		list.append(tileBoxesItem);
+	}
+	else
+	{
+		tileBoxesItem = list.itemAt(index);
+	}
+
+	const MColor wireframeColor = MHWRender::MGeometryUtilities::wireframeColor(path);
+	const float solidColor[] = {wireframeColor.r, wireframeColor.g, wireframeColor.b, 1.0f};
+
+	const bool hasTileBoxes = _frame && _frame->_hasTileBoxes;
+	MHWRender::MShaderInstance* boxShader = shaderManager->getStockShader(MHWRender::MShaderManager::k3dSolidShader);
+	if (boxShader)
+	{
+		boxShader->setParameter("solidColor", solidColor);
+		tileBoxesItem->setShader(boxShader);
+		shaderManager->releaseShader(boxShader);
+	}
+	tileBoxesItem->enable(hasTileBoxes);
+
+	const bool hasParticleData = _frame && _frame->_hasParticleData;
+	const bool hasParticleColor = hasParticleData && _frame->_hasParticleColor;
+	MHWRender::MShaderInstance* shader = shaderManager->getStockShader(
+			hasParticleColor ? MHWRender::MShaderManager::k3dCPVFatPointShader
+							 : MHWRender::MShaderManager::k3dFatPointShader);
+	if (shader)
+	{
+		shader->setParameter("pointSize", POINT_SIZE);
+		if (!hasParticleColor)
+			shader->setParameter("solidColor", solidColor);
+		pointsItem->setShader(shader);
+		shaderManager->releaseShader(shader);
+	}
+	pointsItem->enable(hasParticleData);
+}
+
+void BifrostGeometryOverride::populateGeometry(const MHWRender::MGeometryRequirements& requirements,
+											   const MHWRender::MRenderItemList& renderItems,
+											   MHWRender::MGeometry& data)
+{
+	if (!_frame)
+		return;
+	_populatedFrame = _frame;
+	if (_frame->_hasTileBoxes)
+	{
+		if (!_frame->_tileBoxes.empty())
+			populateTileBoxes(requirements, renderItems, data);
+		return;
+	}
+	if (!_frame->_hasParticleData)
+		return;
+
+	const unsigned int pointCount = static_cast<unsigned int>(_frame->_particlePositions.size() / 3);
+	if (pointCount == 0)
+		return;
+	if (_frame->_hasParticleColor && _frame->_particleColors.size() < pointCount * 3)
+		return;
+
+	const MHWRender::MVertexBufferDescriptorList& descriptors = requirements.vertexRequirements();
+	for (int i=0;i<descriptors.length();i++)
+	{
+		MHWRender::MVertexBufferDescriptor descriptor;
+		if (!descriptors.getDescriptor(i, descriptor))
+			continue;
+
+		switch (descriptor.semantic())
+		{
+		case MHWRender::MGeometry::kPosition:
+		{
+			MHWRender::MVertexBuffer* buffer = data.createVertexBuffer(descriptor);
+			if (!buffer)
+				break;
+			// Write only, Maya does not need to read back the previous content
+			float* positions = static_cast<float*>(buffer->acquire(pointCount, true));
+			if (positions)
+			{
+				memcpy(positions, &(_frame->_particlePositions[0]), pointCount * 3 * sizeof(float));
+				buffer->commit(positions);
+			}
+		}
+		break;
+		case MHWRender::MGeometry::kColor:
+		{
+			if (!_frame->_hasParticleColor)
+				break;
+			MHWRender::MVertexBuffer* buffer = data.createVertexBuffer(descriptor);
+			if (!buffer)
+				break;
+			float* colors = static_cast<float*>(buffer->acquire(pointCount, true));
+			if (colors)
+			{
+				// Frame colors are RGB, the viewport wants RGBA
+				const int dimension = descriptor.dimension();
+				const float* rgb = &(_frame->_particleColors[0]);
+				for (unsigned int p=0;p<pointCount;p++,rgb+=3,colors+=dimension)
+				{
+					colors[0] = rgb[0];
+					colors[1] = rgb[1];
+					colors[2] = rgb[2];
+					if (dimension > 3)
+						colors[3] = 1.0f;
+				}
+				buffer->commit(colors - pointCount * dimension);
+			}
+		}
+		break;
+		default:
+			break;
+		}
+	}
+
+	/*!
+	 * \note Viewport 2.0 render items must be associated with an index
+	 *       buffer, the identity indices are generated straight into the
+	 *       buffer memory instead of being kept with the frame
+	 */
+	for (int i=0;i<renderItems.length();i++)
+	{
+		const MHWRender::MRenderItem* item = renderItems.itemAt(i);
+		if (!item || item->name() != POINTS_RENDER_ITEM_NAME)
+			continue;
+		MHWRender::MIndexBuffer* indexBuffer = data.createIndexBuffer(MHWRender::MGeometry::kUnsignedInt32);
+		if (!indexBuffer)
+			continue;
+		unsigned int* indices = static_cast<unsigned int*>(indexBuffer->acquire(pointCount, true));
+		if (!indices)
+			continue;
+		for (unsigned int p=0;p<pointCount;p++)
+			indices[p] = p;
+		indexBuffer->commit(indices);
+		item->associateWithIndexBuffer(indexBuffer);
+	}
+}
+
+void BifrostGeometryOverride::populateTileBoxes(const MHWRender::MGeometryRequirements& requirements,
+												const MHWRender::MRenderItemList& renderItems,
+												MHWRender::MGeometry& data)
+{
+	const unsigned int boxCount = static_cast<unsigned int>(_frame->_tileBoxes.size() / 6);
+
+	const MHWRender::MVertexBufferDescriptorList& descriptors = requirements.vertexRequirements();
+	for (int i=0;i<descriptors.length();i++)
+	{
+		MHWRender::MVertexBufferDescriptor descriptor;
+		if (!descriptors.getDescriptor(i, descriptor) || descriptor.semantic() != MHWRender::MGeometry::kPosition)
+			continue;
+		MHWRender::MVertexBuffer* buffer = data.createVertexBuffer(descriptor);
+		if (!buffer)
+			continue;
+		float* positions = static_cast<float*>(buffer->acquire(boxCount * 8, true));
+		if (!positions)
+			continue;
+		float* corner = positions;
+		const float* box = &(_frame->_tileBoxes[0]);
+		for (unsigned int b=0;b<boxCount;b++,box+=6)
+		{
+			for (int c=0;c<8;c++,corner+=3)
+			{
+				corner[0] = box[(c & 1) ? 3 : 0];
+				corner[1] = box[(c & 2) ? 4 : 1];
+				corner[2] = box[(c & 4) ? 5 : 2];
+			}
+		}
+		buffer->commit(positions);
+	}
+
+	for (int i=0;i<renderItems.length();i++)
+	{
+		const MHWRender::MRenderItem* item = renderItems.itemAt(i);
+		if (!item || item->name() != TILE_BOXES_RENDER_ITEM_NAME)
+			continue;
+		MHWRender::MIndexBuffer* indexBuffer = data.createIndexBuffer(MHWRender::MGeometry::kUnsignedInt32);
+		if (!indexBuffer)
+			continue;
+		unsigned int* indices = static_cast<unsigned int*>(indexBuffer->acquire(boxCount * 24, true));
+		if (!indices)
+			continue;
+		for (unsigned int b=0;b<boxCount;b++)
+			for (int e=0;e<24;e++)
+				indices[b * 24 + e] = b * 8 + BOX_EDGE_CORNERS[e];
+		indexBuffer->commit(indices);
+		item->associateWithIndexBuffer(indexBuffer);
+	}
+}
+
+void BifrostGeometryOverride::cleanUp()
+{
+	// Do not keep a frame evicted from the loader cache alive
+	_frame.reset();
+}
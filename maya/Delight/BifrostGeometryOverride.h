@@ -0,0 +1,64 @@
+#pragma once
+
+#include <maya/MPxGeometryOverride.h>
+
+#include "BifrostFrameLoader.h"
+
+#include <memory>
+
+class BifrostSurfaceShape;
+
+/*!
+ * \brief Viewport 2.0 drawing of BifrostSurfaceShape particles, or of the
+ *        bounds of their tiles in tile boxes display mode
+ *
+ * Positions (and colors when present) of a decoded frame are written once
+ * straight into the Maya managed vertex buffers, the geometry is only
+ * repopulated when the loader publishes a different frame so the buffers
+ * stay resident on the GPU while the time does not change.
+ */
+class BifrostGeometryOverride : public MHWRender::MPxGeometryOverride
+{
+public:
+	static MHWRender::MPxGeometryOverride* creator(const MObject& obj);
+	virtual ~BifrostGeometryOverride();
+
+	virtual MHWRender::DrawAPI supportedDrawAPIs() const;
+	virtual void updateDG();
+	virtual bool requiresGeometryUpdate() const;
+	virtual void updateRenderItems(const MDagPath& path,
+								   MHWRender::MRenderItemList& list);
+	virtual void populateGeometry(const MHWRender::MGeometryRequirements& requirements,
+								  const MHWRender::MRenderItemList& renderItems,
+								  MHWRender::MGeometry& data);
+	virtual void cleanUp();
+
+	/*! \brief Classification used to register the shape and the override */
+	static const char* drawDbClassification;
+	static const char* drawRegistrantId;
+private:
+	BifrostGeometryOverride(const MObject& obj);
+	/*! \brief Line geometry of the occupied tiles in tile boxes display mode */
+	void populateTileBoxes(const MHWRender::MGeometryRequirements& requirements,
+						   const MHWRender::MRenderItemList& renderItems,
+						   MHWRender::MGeometry& data);
+
+	BifrostSurfaceShape* _shape;
+	/*! \brief Frame picked up by updateDG for this draw */
+	BifrostFrameDataConstPtr _frame;
+	/*! \brief Frame held by the current Maya buffers, weak to not delay its eviction */
+	std::weak_ptr<const BifrostFrameData> _populatedFrame;
+};
+// == Emacs ================
+// -------------------------
+// Local variables:
+// tab-width: 4
+// indent-tabs-mode: t
+// c-basic-offset: 4
+// end:
+//
+// == vi ===================
+// -------------------------
+// Format block
+// ex:ts=4:sw=4:expandtab
+// -------------------------
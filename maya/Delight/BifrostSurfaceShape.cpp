@@ -3,6 +3,7 @@
 #include <maya/MFnUnitAttribute.h>
 #include <maya/MFnTypedAttribute.h>
 #include <maya/MFnNumericAttribute.h>
+#include <maya/MFnEnumAttribute.h>
 #include <maya/MFnMatrixAttribute.h>
 #include <maya/MFnStringData.h>
 #include <maya/MFnStringArrayData.h>
@@ -10,26 +11,39 @@
 #include <maya/MFnPointArrayData.h>
 #include <maya/MBoundingBox.h>
 #include <maya/MTime.h>
+#include <maya/MDagPath.h>
+#include <maya/MPlug.h>
 
 #include <stdio.h>
+#include <math.h>
+#include <algorithm>
 #include <boost/format.hpp>
 
 #include "MayaUtils.h"
 
+/*! \brief displayMode values */
+const short DISPLAY_POINTS = 0;
+const short DISPLAY_TILE_BOXES = 1;
+
 MTypeId BifrostSurfaceShape::typeId(0x0011BDC0);
 MObject BifrostSurfaceShape::_inBifrostFileAttr;
 MObject BifrostSurfaceShape::_inTimeAttr;
 // MObject BifrostSurfaceShape::_inParticleWidthAttr;
 MObject BifrostSurfaceShape::_inVelocityMotionBlurAttr;
 MObject BifrostSurfaceShape::_inGeometryChunkAttr;
+MObject BifrostSurfaceShape::_inRenderTileClusterAttr;
+MObject BifrostSurfaceShape::_inPrefetchFramesAttr;
+MObject BifrostSurfaceShape::_inCacheMemoryAttr;
+MObject BifrostSurfaceShape::_inDisplayPointBudgetAttr;
+MObject BifrostSurfaceShape::_inDisplayModeAttr;
+MObject BifrostSurfaceShape::_inPreviewSurfaceAttr;
 MObject BifrostSurfaceShape::_outChannelNamesAttr;
 MObject BifrostSurfaceShape::_outBoundingBoxAttr;
 
 BifrostSurfaceShape::BifrostSurfaceShape()
-: _particleBBox(MBoundingBox(MPoint(-1,-1,-1),MPoint(1,1,1)))
-, _hasParticleColor(false)
-, _hasParticleData(false)
-, _BifrostFilePathChanged(false)
+: _BifrostFilePathChanged(false)
+, _frameNumber(0)
+, _playbackDirection(1)
 {
 }
 
@@ -48,6 +62,19 @@ void BifrostSurfaceShape::draw (M3dView& view,
 		M3dView::DisplayStyle style,
 		M3dView::DisplayStatus status)
 {
+	BifrostFrameDataConstPtr frame = _loader.latest();
+	if (frame != _drawnFrame)
+	{
+		// A new frame was published by the loader since the last draw
+		_drawnFrame = frame;
+		childChanged( MPxSurfaceShape::kBoundingBoxChanged );
+	}
+	const bool hasParticleData = frame && frame->_hasParticleData;
+	static const BodyMeshDataCollection noMesh;
+	static const BodyFieldDataCollection noField;
+	const BodyMeshDataCollection& bm = frame ? frame->_bm : noMesh;
+	const BodyFieldDataCollection& bf = frame ? frame->_bf : noField;
+
 	switch (style)
 	{
 	case M3dView::kBoundingBox:
@@ -55,22 +82,22 @@ void BifrostSurfaceShape::draw (M3dView& view,
 		view.beginGL();
 		glPushAttrib(GL_CURRENT_BIT);
 
-		BodyMeshDataCollection::const_iterator mEiter = _bm.end();
-		BodyMeshDataCollection::const_iterator mIter  = _bm.begin();
+		BodyMeshDataCollection::const_iterator mEiter = bm.end();
+		BodyMeshDataCollection::const_iterator mIter  = bm.begin();
 		for (;mIter!=mEiter;++mIter)
 		{
 			drawBBox(mIter->_meshBBox);
 		}
 
-		BodyFieldDataCollection::const_iterator fEiter = _bf.end();
-		BodyFieldDataCollection::const_iterator fIter  = _bf.begin();
+		BodyFieldDataCollection::const_iterator fEiter = bf.end();
+		BodyFieldDataCollection::const_iterator fIter  = bf.begin();
 		for (;fIter!=fEiter;++fIter)
 		{
 			drawBBox(fIter->_fieldBBox);
 		}
 
-		if (_hasParticleData)
-			drawBBox(_particleBBox);
+		if (hasParticleData)
+			drawBBox(frame->_particleBBox);
 
 		glPopAttrib();
 		view.endGL();
@@ -80,29 +107,46 @@ void BifrostSurfaceShape::draw (M3dView& view,
 	case M3dView::kPoints:
 	{
 		// NOTE : Client state enable/disable order must reverse each other (like a stack)
-		if (_hasParticleData)
+		if (hasParticleData)
 		{
 			view.beginGL();
 			glPushAttrib(GL_CURRENT_BIT);
 			glEnableClientState(GL_VERTEX_ARRAY);
-			if (_hasParticleColor)
+			if (frame->_hasParticleColor)
 				glEnableClientState(GL_COLOR_ARRAY);
-			glVertexPointer(3,GL_FLOAT,0,&_particlePositions[0]);
-			if (_hasParticleColor)
-				glColorPointer(3,GL_FLOAT,0,&_particleColors[0]);
-			glDrawElements(GL_POINTS,_particlePositions.size()/3,GL_UNSIGNED_INT,&_particleGLIndices[0]);
-			if (_hasParticleColor)
+			glVertexPointer(3,GL_FLOAT,0,&(frame->_particlePositions[0]));
+			if (frame->_hasParticleColor)
+				glColorPointer(3,GL_FLOAT,0,&(frame->_particleColors[0]));
+			glDrawArrays(GL_POINTS,0,frame->_particlePositions.size()/3);
+			if (frame->_hasParticleColor)
 				glDisableClientState(GL_COLOR_ARRAY);
 			glDisableClientState(GL_VERTEX_ARRAY);
 			glPopAttrib();
 			view.endGL();
 		}
-		else if (_bm.size() != 0)
+		else if (frame && frame->_hasTileBoxes)
+		{
+			view.beginGL();
+			glPushAttrib(GL_CURRENT_BIT);
+			drawTileBoxes(*frame);
+			glPopAttrib();
+			view.endGL();
+		}
+		else if (!frame && _loader.busy())
+		{
+			// Nothing decoded yet, show where the shape is while loading
+			view.beginGL();
+			glPushAttrib(GL_CURRENT_BIT);
+			drawBBox(boundingBox());
+			glPopAttrib();
+			view.endGL();
+		}
+		else if (bm.size() != 0)
 		{
 			// Draw the mesh vertices as points
 			view.beginGL();
-			BodyMeshDataCollection::const_iterator mEiter = _bm.end();
-			BodyMeshDataCollection::const_iterator mIter  = _bm.begin();
+			BodyMeshDataCollection::const_iterator mEiter = bm.end();
+			BodyMeshDataCollection::const_iterator mIter  = bm.begin();
 			for (;mIter!=mEiter;++mIter)
 			{
 				glPushAttrib(GL_CURRENT_BIT);
@@ -112,8 +156,7 @@ void BifrostSurfaceShape::draw (M3dView& view,
 				glVertexPointer(3,GL_FLOAT,0,&(mIter->_meshPositions[0]));
 				if (mIter->_hasMeshVertexColor)
 					glColorPointer(3,GL_FLOAT,0,&(mIter->_meshColors[0]));
-				glDrawElements(GL_POINTS,mIter->_meshPositions.size()/3,GL_UNSIGNED_INT,
-						&(mIter->_meshVertexGLIndices[0]));
+				glDrawArrays(GL_POINTS,0,mIter->_meshPositions.size()/3);
 				if (mIter->_hasMeshVertexColor)
 					glDisableClientState(GL_COLOR_ARRAY);
 				glDisableClientState(GL_VERTEX_ARRAY);
@@ -126,12 +169,20 @@ void BifrostSurfaceShape::draw (M3dView& view,
 	break;
 	case M3dView::kWireFrame:
 	{
-		if (_bm.size() != 0)
+		if (frame && frame->_hasTileBoxes)
+		{
+			view.beginGL();
+			glPushAttrib(GL_CURRENT_BIT);
+			drawTileBoxes(*frame);
+			glPopAttrib();
+			view.endGL();
+		}
+		if (bm.size() != 0)
 		{
 			view.beginGL();
 
-			BodyMeshDataCollection::const_iterator mEiter = _bm.end();
-			BodyMeshDataCollection::const_iterator mIter  = _bm.begin();
+			BodyMeshDataCollection::const_iterator mEiter = bm.end();
+			BodyMeshDataCollection::const_iterator mIter  = bm.begin();
 			for (;mIter!=mEiter;++mIter)
 			{
 				glPushAttrib(GL_CURRENT_BIT);
@@ -155,11 +206,11 @@ void BifrostSurfaceShape::draw (M3dView& view,
 	break;
 	case M3dView::kFlatShaded:
 	{
-		if (_bm.size() != 0)
+		if (bm.size() != 0)
 		{
 			view.beginGL();
-			BodyMeshDataCollection::const_iterator mEiter = _bm.end();
-			BodyMeshDataCollection::const_iterator mIter  = _bm.begin();
+			BodyMeshDataCollection::const_iterator mEiter = bm.end();
+			BodyMeshDataCollection::const_iterator mIter  = bm.begin();
 			for (;mIter!=mEiter;++mIter)
 			{
 				glPushAttrib(GL_CURRENT_BIT);
@@ -183,12 +234,11 @@ void BifrostSurfaceShape::draw (M3dView& view,
 	break;
 	case M3dView::kGouraudShaded:
 	{
-		/*! \todo Need to handle vertex normal if available */
-		if (_bm.size() != 0)
+		if (bm.size() != 0)
 		{
 			view.beginGL();
-			BodyMeshDataCollection::const_iterator mEiter = _bm.end();
-			BodyMeshDataCollection::const_iterator mIter  = _bm.begin();
+			BodyMeshDataCollection::const_iterator mEiter = bm.end();
+			BodyMeshDataCollection::const_iterator mIter  = bm.begin();
 			for (;mIter!=mEiter;++mIter)
 			{
 				glPushAttrib(GL_CURRENT_BIT);
@@ -200,9 +250,14 @@ void BifrostSurfaceShape::draw (M3dView& view,
 				if (mIter->_hasMeshVertexColor)
 					glColorPointer(3,GL_FLOAT,0,&(mIter->_meshColors[0]));
 				if (mIter->_hasMeshVertexNormal)
+				{
+					glEnableClientState(GL_NORMAL_ARRAY);
 					glNormalPointer(GL_FLOAT,0,&(mIter->_meshNormals[0]));
+				}
 				glDrawElements(GL_TRIANGLES,mIter->_meshGLIndices.size(),GL_UNSIGNED_INT,
 						&(mIter->_meshGLIndices[0]));
+				if (mIter->_hasMeshVertexNormal)
+					glDisableClientState(GL_NORMAL_ARRAY);
 				if (mIter->_hasMeshVertexColor)
 					glDisableClientState(GL_COLOR_ARRAY);
 				glDisableClientState(GL_VERTEX_ARRAY);
@@ -225,41 +280,11 @@ bool BifrostSurfaceShape::isBounded() const
 
 MBoundingBox BifrostSurfaceShape::boundingBox() const
 {
-	MGlobal::displayInfo("boundingBox() called");
-	if (_bm.size() != 0)
-	{
-		MBoundingBox bbox;
-		BodyMeshDataCollection::const_iterator mEiter = _bm.end();
-		BodyMeshDataCollection::const_iterator mIter  = _bm.begin();
-		for (;mIter!=mEiter;++mIter)
-		{
-			bbox.expand(mIter->_meshBBox);
-		}
-		MGlobal::displayInfo("boundingBox() return bbox[body mesh]");
-		return bbox;
-	}
-	else if (_bf.size() != 0)
-	{
-		MBoundingBox bbox;
-		BodyFieldDataCollection::const_iterator fEiter = _bf.end();
-		BodyFieldDataCollection::const_iterator fIter  = _bf.begin();
-		for (;fIter!=fEiter;++fIter)
-		{
-			bbox.expand(fIter->_fieldBBox);
-		}
-		MGlobal::displayInfo("boundingBox() return bbox[body field]");
-		return bbox;
-	}
-	else if (_hasParticleData)
-	{
-		MGlobal::displayInfo("boundingBox() return bbox[particle]");
-		return _particleBBox;
-	}
-	else
-	{
-		MGlobal::displayInfo("boundingBox() return bbox[default unit]");
-		return MBoundingBox(MPoint(-1,-1,-1),MPoint(1,1,1));
-	}
+	// Maya asks for it many times per refresh, the loader computed it once per frame
+	BifrostFrameDataConstPtr frame = _loader.latest();
+	if (frame && frame->_hasBBox)
+		return frame->_bbox;
+	return MBoundingBox(MPoint(-1,-1,-1),MPoint(1,1,1));
 }
 
 void BifrostSurfaceShape::setChannelNamesList(const MStringArray& attrList)
@@ -276,118 +301,6 @@ void BifrostSurfaceShape::setChannelNamesList(const MStringArray& attrList)
 	}
 }
 
-template<typename T>
-bool BifrostSurfaceShape::processChannelData(Bifrost::API::Component& component,
-		Bifrost::API::Channel& channel_data,
-		bool i_is_point_position,
-		std::vector<T>& o_channel_data_array) const
-{
-	Bifrost::API::Layout layout = component.layout();
-	float voxel_scale = layout.voxelScale();
-	size_t depthCount = layout.depthCount();
-
-
-	for ( size_t d=0; d<depthCount; d++ ) {
-		size_t tcount = layout.tileCount(d);
-		for ( size_t t=0; t<tcount; t++ ) {
-			Bifrost::API::TreeIndex tindex(t,d);
-			if ( !channel_data.elementCount( tindex ) ) {
-				// nothing there
-				continue;
-			}
-			Bifrost::API::TileData<T> data_element = channel_data.tileData<T>( tindex );
-			for (size_t i=0; i<data_element.count(); i++ ) {
-				if (i_is_point_position)
-					o_channel_data_array.push_back(data_element[i] * voxel_scale);
-				else
-					o_channel_data_array.push_back(data_element[i]);
-			}
-		}
-	}
-	return true;
-}
-
-bool BifrostSurfaceShape::loadParticleData(const MString& i_bifrost_filename,
-										   GLfloatVector& o_particlePositions,
-										   GLuintVector&  o_particleGLIndices)
-{
-	o_particlePositions.clear();
-	o_particleGLIndices.clear();
-
-	Bifrost::API::String biffile = i_bifrost_filename.asChar();
-
-	Bifrost::API::ObjectModel om;
-	Bifrost::API::FileIO fileio = om.createFileIO( biffile );
-	Bifrost::API::StateServer ss = fileio.load( );
-	const Bifrost::API::BIF::FileInfo& info = fileio.info();
-
-	if ( !ss.valid() ) {
-		std::cerr << boost::format("Unable to load the content of the Bifrost file \"%1%\"") % biffile.c_str()
-                				  << std::endl;
-		return false;
-	}
-
-	Bifrost::API::Component component = ss.components()[0];
-	if ( component.type() != Bifrost::API::PointComponentType ) {
-		std::cerr << "Wrong component (" << component.type() << ")" << std::endl;
-		return false;
-	}
-
-	// float bifrost_scale = 0.0;
-
-	Bifrost::API::RefArray channels = component.channels();
-
-	for (size_t channelIndex=0;channelIndex<info.channelCount;channelIndex++)
-	{
-		const Bifrost::API::BIF::FileInfo::ChannelInfo& channelInfo = fileio.channelInfo(channelIndex);
-		std::cout << boost::format("channelInfo.name = %1%") % channelInfo.name.c_str() << std::endl;
-		bool is_point_position = channelInfo.name.find("position") != Bifrost::API::String::npos;
-
-		if (is_point_position)
-		{
-			std::cout << boost::format("FOUND position = %1%") % channelInfo.name.c_str() << std::endl;
-			switch (channelInfo.dataType)
-			{
-			case		Bifrost::API::FloatV3Type:	/*!< Defines a channel of type amino::Math::vec3f. #3 */
-			{
-				std::cout << "FOUND suitable FloatV3Type"<< std::endl;
-				typedef amino::Math::vec3f DataType;
-				std::vector<DataType> channel_data_array;
-				Bifrost::API::Channel channel = channels[channelIndex];
-
-				bool successfully_processed = processChannelData<DataType>(component,channel,is_point_position,channel_data_array);
-				if (successfully_processed)
-				{
-					size_t numParticles = channel_data_array.size();
-					std::cout << boost::format("SUCCESSFULLY processed %1% points") % numParticles << std::endl;
-					//								for (size_t i = 0; i<numParticles;i++)
-					//									v3_array.array()[i].assign(channel_data_array[i].v[0],channel_data_array[i].v[1],channel_data_array[i].v[2]);
-					for (size_t i = 0; i<numParticles;i++)
-					{
-						o_particlePositions.push_back(channel_data_array[i].v[0]);
-						o_particlePositions.push_back(channel_data_array[i].v[1]);
-						o_particlePositions.push_back(channel_data_array[i].v[2]);
-						_particleBBox.expand(MPoint(channel_data_array[i].v[0],channel_data_array[i].v[1],channel_data_array[i].v[2]));
-						o_particleGLIndices.push_back(i);
-					}
-					_hasParticleData = true;
-
-				}
-				else
-				{
-					// Return early, no point processing the other attribute if position is not found
-					return false;
-				}
-			}
-			break;
-			default:
-				break;
-			}
-		}
-	}
-	return true;
-}
-
 void BifrostSurfaceShape::drawBBox(const MBoundingBox& bbox) const
 {
 	glBegin( GL_LINE_LOOP );
@@ -419,6 +332,16 @@ void BifrostSurfaceShape::drawBBox(const MBoundingBox& bbox) const
 	glEnd();
 }
 
+void BifrostSurfaceShape::drawTileBoxes(const BifrostFrameData& frame) const
+{
+	const size_t boxCount = frame._tileBoxes.size() / 6;
+	const float* box = frame._tileBoxes.empty() ? 0 : &(frame._tileBoxes[0]);
+	for (size_t i=0;i<boxCount;i++,box+=6)
+	{
+		drawBBox(MBoundingBox(MPoint(box[0],box[1],box[2]),MPoint(box[3],box[4],box[5])));
+	}
+}
+
 /*!
  * \note If we ever need to refactor *SurfaceShape
  * to an abstract class for reuse across different
@@ -427,7 +350,6 @@ void BifrostSurfaceShape::drawBBox(const MBoundingBox& bbox) const
  */
 MStatus BifrostSurfaceShape::compute( const MPlug& plug, MDataBlock& data_block )
 {
-	MGlobal::displayInfo("compute() called");
 	char debugStringBuf[BUFSIZ];
 
 	// MGlobal::displayInfo("BifrostSurfaceShape::compute");
@@ -436,15 +358,58 @@ MStatus BifrostSurfaceShape::compute( const MPlug& plug, MDataBlock& data_block
 	// if ( !data_block.isClean( _inBifrostFileAttr ) )
 	{
 		CMS(MDataHandle inputPathHdl = data_block.inputValue( _inBifrostFileAttr, &status ));
-		MString bifrostFilePath = inputPathHdl.asString();
-		if (bifrostFilePath.length()>0 && _BifrostFilePath != bifrostFilePath)
+		MString bifrostFilePattern = inputPathHdl.asString();
+		CMS(MDataHandle inputTimeHdl = data_block.inputValue( _inTimeAttr, &status ));
+		int frame = frameNumber(inputTimeHdl.asTime());
+		CMS(MDataHandle inputPrefetchHdl = data_block.inputValue( _inPrefetchFramesAttr, &status ));
+		int prefetchFrames = inputPrefetchHdl.asInt();
+		CMS(MDataHandle inputCacheMemoryHdl = data_block.inputValue( _inCacheMemoryAttr, &status ));
+		int cacheMemory = inputCacheMemoryHdl.asInt();
+
+		CMS(MDataHandle inputPointBudgetHdl = data_block.inputValue( _inDisplayPointBudgetAttr, &status ));
+		int pointBudget = inputPointBudgetHdl.asInt();
+		CMS(MDataHandle inputDisplayModeHdl = data_block.inputValue( _inDisplayModeAttr, &status ));
+		short displayMode = inputDisplayModeHdl.asShort();
+		CMS(MDataHandle inputPreviewSurfaceHdl = data_block.inputValue( _inPreviewSurfaceAttr, &status ));
+		bool previewSurface = inputPreviewSurfaceHdl.asBool();
+
+		_loader.setMemoryBudget(size_t(std::max(cacheMemory,0)) * 1024 * 1024);
+
+		BifrostDisplaySettings settings;
+		settings._pointBudget = static_cast<size_t>(std::max(pointBudget,0));
+		settings._tileBoxes = (displayMode == DISPLAY_TILE_BOXES);
+		settings._previewSurface = previewSurface;
+		// Cached frames were decoded with the previous settings
+		bool settingsChanged = _loader.setDisplaySettings(settings);
+
+		MString bifrostFilePath = frameFilePath(bifrostFilePattern,frame).c_str();
+		if (bifrostFilePath.length()>0 && (_BifrostFilePath != bifrostFilePath || settingsChanged))
 		{
-			MGlobal::displayInfo((boost::format("compute() NEW _inBifrostFileAttr = '%1%'") % bifrostFilePath.asChar()).str().c_str());
 			_BifrostFilePathChanged = true;
 			_BifrostFilePath = bifrostFilePath;
 
-			if (!loadParticleData(_BifrostFilePath,_particlePositions,_particleGLIndices))
-				return MStatus::kFailure;
+			// Scrubbing backward prefetches backward
+			if (frame != _frameNumber)
+				_playbackDirection = (frame > _frameNumber) ? 1 : -1;
+			_frameNumber = frame;
+
+			BifrostFrameLoader::StringContainer prefetch;
+			for (int i=1;i<=prefetchFrames;i++)
+			{
+				std::string prefetchFilePath = frameFilePath(bifrostFilePattern,frame + i * _playbackDirection);
+				// A path without frame pattern has nothing to prefetch
+				if (prefetchFilePath == _BifrostFilePath.asChar())
+					break;
+				prefetch.push_back(prefetchFilePath);
+			}
+
+			// Viewport 2.0 only repopulates the geometry of a dirty shape
+			MDagPath shapePath;
+			if (MDagPath::getAPathTo(thisMObject(),shapePath))
+				_loader.setPublishCommand((boost::format("dgdirty \"%1%\"; refresh") % shapePath.fullPathName().asChar()).str());
+
+			// Decoded on the loader threads, draw keeps the previous frame meanwhile
+			_loader.request(_BifrostFilePath.asChar(),prefetch);
 		}
 	}
 
@@ -464,22 +429,71 @@ void BifrostSurfaceShape::update()
 }
 
 
-void BifrostSurfaceShape::accumulateMotionData()
+void BifrostSurfaceShape::accumulateMotionData(double i_sampleTime)
 {
+	MStatus status;
+	MPlug filePlug( thisMObject(), _inBifrostFileAttr );
+	MString pattern;
+	CMSV(status = filePlug.getValue( pattern ));
+	std::string filename = frameFilePath(pattern, frameNumber(MTime(i_sampleTime, MTime::uiUnit())));
+
+	// Samples resolving to the same file, such as sub-frame samples rounded up
+	// to one frame, share one decoded frame
+	for (MotionSampleContainer::const_iterator iter = _motionSamples.begin(); iter != _motionSamples.end(); ++iter)
+	{
+		if (iter->second->_filename == filename)
+		{
+			_motionSamples[i_sampleTime] = iter->second;
+			return;
+		}
+	}
+	BifrostFrameDataConstPtr frame = _loader.load(filename);
+	if (!frame)
+	{
+		MGlobal::displayError((boost::format("Unable to decode the motion sample %1% from \"%2%\"") % i_sampleTime % filename).str().c_str());
+		return;
+	}
+	_motionSamples[i_sampleTime] = frame;
 }
 
 void BifrostSurfaceShape::clearMotionData()
 {
+	// Frames still in the loader cache stay alive there
+	_motionSamples.clear();
+}
+
+const BifrostSurfaceShape::MotionSampleContainer& BifrostSurfaceShape::motionSamples() const
+{
+	return _motionSamples;
+}
+
+BifrostFrameDataConstPtr BifrostSurfaceShape::latestFrame() const
+{
+	return _loader.latest();
 }
 
 bool BifrostSurfaceShape::hasGeometryData() const
 {
-	return ( _bm.size() != 0 || _bp.size() != 0 );
+	BifrostFrameDataConstPtr frame = _loader.latest();
+	return frame && ( frame->_bm.size() != 0 || frame->_hasParticleData );
 }
 
 bool BifrostSurfaceShape::hasFieldData() const
 {
-	return (_bf.size() != 0);
+	BifrostFrameDataConstPtr frame = _loader.latest();
+	return frame && (frame->_bf.size() != 0);
+}
+
+int BifrostSurfaceShape::frameNumber(const MTime& i_time)
+{
+	return static_cast<int>(ceil(i_time.as( MTime::uiUnit() )));
+}
+
+std::string BifrostSurfaceShape::frameFilePath(const MString& i_pattern, int i_frame)
+{
+	char numberedFrameBifrostFilePath[2048];
+	snprintf(numberedFrameBifrostFilePath,sizeof(numberedFrameBifrostFilePath),i_pattern.asChar(),i_frame);
+	return numberedFrameBifrostFilePath;
 }
 
 void* BifrostSurfaceShape::creator()
@@ -492,6 +506,7 @@ MStatus BifrostSurfaceShape::initialize()
 	MFnUnitAttribute uAttr;
 	MFnTypedAttribute tAttr;
 	MFnNumericAttribute nAttr;
+	MFnEnumAttribute eAttr;
 	MFnMatrixAttribute mAttr;
 	MFnStringData stringData;
 	MFnStringArrayData stringArrayData;
@@ -526,6 +541,41 @@ MStatus BifrostSurfaceShape::initialize()
 	CMS(status = nAttr.setKeyable(true));
 	CMS(status = addAttribute( _inGeometryChunkAttr ));
 
+	// Point tiles per emitted RenderMan procedural, 0 emits a single procedural
+	CMS(_inRenderTileClusterAttr = nAttr.create( "renderTileCluster", "rtc", MFnNumericData::kLong, 0, &status ));
+	CMS(status = nAttr.setMin(0));
+	CMS(status = nAttr.setSoftMax(1024));
+	CMS(status = addAttribute( _inRenderTileClusterAttr ));
+
+	// Frames decoded ahead of the current one in the playback direction
+	CMS(_inPrefetchFramesAttr = nAttr.create( "prefetchFrames", "pff", MFnNumericData::kLong, 4, &status ));
+	CMS(status = nAttr.setMin(0));
+	CMS(status = nAttr.setSoftMax(16));
+	CMS(status = addAttribute( _inPrefetchFramesAttr ));
+
+	// Memory budget of the decoded frame cache in megabytes
+	CMS(_inCacheMemoryAttr = nAttr.create( "cacheMemory", "cmm", MFnNumericData::kLong, 1024, &status ));
+	CMS(status = nAttr.setMin(0));
+	CMS(status = nAttr.setSoftMax(16384));
+	CMS(status = addAttribute( _inCacheMemoryAttr ));
+
+	// Viewport point budget, every tile keeps the same stable fraction of its points
+	CMS(_inDisplayPointBudgetAttr = nAttr.create( "displayPointBudget", "dpb", MFnNumericData::kLong, 2000000, &status ));
+	CMS(status = nAttr.setMin(0));
+	CMS(status = nAttr.setSoftMax(10000000));
+	CMS(status = addAttribute( _inDisplayPointBudgetAttr ));
+
+	// Viewport display of the particles
+	CMS(_inDisplayModeAttr = eAttr.create( "displayMode", "dsm", DISPLAY_POINTS, &status ));
+	CMS(status = eAttr.addField( "Points", DISPLAY_POINTS ));
+	CMS(status = eAttr.addField( "Tile Boxes", DISPLAY_TILE_BOXES ));
+	CMS(status = addAttribute( _inDisplayModeAttr ));
+
+	// Blocky surface of the voxel caches (liquid distance, Aero density)
+	CMS(_inPreviewSurfaceAttr = nAttr.create( "previewSurface", "psf", MFnNumericData::kBoolean, false, &status ));
+	CMS(status = nAttr.setKeyable(true));
+	CMS(status = addAttribute( _inPreviewSurfaceAttr ));
+
 	// Output channel names attribute
 	// CMS(_outChannelNamesAttr = tAttr.create( "outChannelNames", "ocn", MFnData::kString ,stringData.create(MString("")), &status));
 	CMS(_outChannelNamesAttr = tAttr.create("outChannelNames", "ocn", MFnData::kStringArray,
@@ -548,6 +598,11 @@ MStatus BifrostSurfaceShape::initialize()
 	CMS(status = attributeAffects( _inBifrostFileAttr, _outChannelNamesAttr ));
 	CMS(status = attributeAffects( _inBifrostFileAttr, _outBoundingBoxAttr ));
 	CMS(status = attributeAffects( _inTimeAttr, _outBoundingBoxAttr ));
+	CMS(status = attributeAffects( _inPrefetchFramesAttr, _outBoundingBoxAttr ));
+	CMS(status = attributeAffects( _inCacheMemoryAttr, _outBoundingBoxAttr ));
+	CMS(status = attributeAffects( _inDisplayPointBudgetAttr, _outBoundingBoxAttr ));
+	CMS(status = attributeAffects( _inDisplayModeAttr, _outBoundingBoxAttr ));
+	CMS(status = attributeAffects( _inPreviewSurfaceAttr, _outBoundingBoxAttr ));
 
 	return status;
 }
@@ -20,34 +20,16 @@
 #include <maya/MStatus.h>
 #include <maya/M3dView.h>
 #include <maya/MStringArray.h>
+#include <maya/MTime.h>
 
+#include "BifrostFrameLoader.h"
+
+#include <map>
+#include <string>
 #include <vector>
 
 class BifrostSurfaceShape : public MPxSurfaceShape
 {
-	typedef std::vector<GLfloat> GLfloatVector;
-	typedef std::vector<GLuint> GLuintVector;
-	struct BodyMeshData {
-		MBoundingBox _meshBBox;
-		GLfloatVector _meshPositions;
-		GLfloatVector _meshColors;
-		GLfloatVector _meshNormals;
-		GLuintVector _meshGLIndices;
-		GLuintVector _meshVertexGLIndices;
-		bool _hasMeshVertexColor;
-		bool _hasMeshVertexNormal;
-	};
-	struct BodyParticleData {
-		GLfloatVector _particlePositions;
-		GLfloatVector _particleColors;
-		GLuintVector _particleGLIndices;
-	};
-	struct BodyFieldData {
-		MBoundingBox _fieldBBox;
-	};
-	typedef std::vector<BodyMeshData> BodyMeshDataCollection;
-	typedef std::vector<BodyParticleData> BodyParticleDataCollection;
-	typedef std::vector<BodyFieldData> BodyFieldDataCollection;
 public:
 	BifrostSurfaceShape();
 	virtual ~BifrostSurfaceShape();
@@ -65,52 +47,69 @@ public:
  	/*! \brief use by BifrostSurfaceShapeUI to update node */
  	void update();
 
+	/*! \brief Decoded frame of each motion sample, keyed by sample time */
+	typedef std::map<double,BifrostFrameDataConstPtr> MotionSampleContainer;
 	/*! \brief Accumulate motion block data during 3Delight -addstep call */
-	void accumulateMotionData();
+	void accumulateMotionData(double i_sampleTime);
 	/*! \brief Clears the accumulated motion data to free up the memory */
 	void clearMotionData();
+	/*! \brief Motion samples accumulated since the last clearMotionData() */
+	const MotionSampleContainer& motionSamples() const;
+
+	/*! \brief Last decoded frame, shared with the Viewport 2.0 override */
+	BifrostFrameDataConstPtr latestFrame() const;
 
 	/*! \brief Do we have body geometry data */
 	bool hasGeometryData() const;
 	/*! \brief Do we have body field data */
 	bool hasFieldData() const;
 
+	/*!
+	 * \brief Frame number used to resolve the BifrostFile pattern at
+	 *        the given time, shared with the 3Delight cache command
+	 */
+	static int frameNumber(const MTime& i_time);
+	/*!
+	 * \brief Expand the printf style frame pattern (e.g. "fluid.%04d.bif")
+	 *        of a BifrostFile value, a path without pattern is returned as is
+	 */
+	static std::string frameFilePath(const MString& i_pattern, int i_frame);
+
 	// Parent class method to implement
 	static void *  creator();
 	static MStatus initialize();
 	static MTypeId typeId;
 private:
-	template<typename T>
-	bool processChannelData(Bifrost::API::Component& component,
-							Bifrost::API::Channel& channel_data,
-							bool i_is_point_position,
-							std::vector<T>& o_channel_data_array) const;
 	void setChannelNamesList(const MStringArray& attrList);
-	bool loadParticleData(const MString& i_bifrost_filename,
-						  GLfloatVector& o_particlePositions,
-						  GLuintVector& o_particleGLIndices);
     void drawBBox(const MBoundingBox& bbox) const;
-	MBoundingBox _particleBBox;
+	void drawTileBoxes(const BifrostFrameData& frame) const;
 	static MObject _inBifrostFileAttr;
 	static MObject _inTimeAttr;
 	// static MObject _inParticleWidthAttr;
 	static MObject _inVelocityMotionBlurAttr;
 	static MObject _inGeometryChunkAttr;
+	static MObject _inRenderTileClusterAttr;
+	static MObject _inPrefetchFramesAttr;
+	static MObject _inCacheMemoryAttr;
+	static MObject _inDisplayPointBudgetAttr;
+	static MObject _inDisplayModeAttr;
+	static MObject _inPreviewSurfaceAttr;
 	static MObject _outChannelNamesAttr;
 	static MObject _outBoundingBoxAttr;
 	MStringArray   fAttributeListArray;
-	GLfloatVector _particlePositions;
-	GLfloatVector _particleColors;
-	GLuintVector _particleGLIndices;
 
 	MString _BifrostFilePath;
 	bool _BifrostFilePathChanged;
-	bool _hasParticleColor;
-	bool _hasParticleData;
+	/*! \brief Last frame requested and the direction playback went to it */
+	int _frameNumber;
+	int _playbackDirection;
+
+	/*! \brief Background decoding, draw uses the last completed frame */
+	BifrostFrameLoader _loader;
+	/*! \brief Frame used by the last draw, to detect newly published frames */
+	BifrostFrameDataConstPtr _drawnFrame;
+	MotionSampleContainer _motionSamples;
 
-	BodyMeshDataCollection _bm;
-	BodyParticleDataCollection _bp;
-	BodyFieldDataCollection _bf;
 };
 // == Emacs ================
 // -------------------------
@@ -7,10 +7,223 @@
 #include <maya/MTime.h>
 #include "MayaUtils.h"
 #include "BifrostSurfaceShape.h"
+#include <utils/BifrostUtils.h>
 #include <ri.h>
 #include <fstream>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
 #include <boost/format.hpp>
 
+/*! \brief Point radius given to the bifrost procedural, also pads the bounds */
+const float RENDER_POINT_RADIUS = 1.0f;
+
+/*!
+ * \brief Range of point tiles emitted as one RenderMan procedural
+ */
+struct RenderTileCluster
+{
+	size_t componentIndex;
+	size_t tileDepth;
+	size_t tileIndex;
+	size_t tileCount;
+	MBoundingBox bbox;
+};
+typedef std::vector<RenderTileCluster> RenderTileClusterContainer;
+
+/*!
+ * \brief Bounds of the point tiles of a Bifrost file grouped by
+ *        i_tilesPerCluster (0 groups all the tiles of a depth)
+ *
+ * The tile bounds come from the tile tree, they enclose the points of the
+ * tile without reading their positions. Each cluster is padded by its
+ * fastest point moving for i_velocityPadding seconds, only the velocity
+ * channel is read and only when i_velocityPadding is not 0, and by the
+ * point radius.
+ */
+bool computeRenderTileClusters(const std::string& i_filename,
+							   size_t i_tilesPerCluster,
+							   float i_velocityPadding,
+							   float i_pointRadius,
+							   RenderTileClusterContainer& o_clusters)
+{
+	o_clusters.clear();
+
+	Bifrost::API::String biffile = i_filename.c_str();
+	Bifrost::API::ObjectModel om;
+	Bifrost::API::FileIO fileio = om.createFileIO( biffile );
+	Bifrost::API::StateServer ss = fileio.load( );
+	if ( !ss.valid() ) {
+		MGlobal::displayError((boost::format("Unable to load the content of the Bifrost file \"%1%\"") % i_filename).str().c_str());
+		return false;
+	}
+
+	size_t numComponents = ss.components().count();
+	for (size_t componentIndex=0;componentIndex<numComponents;componentIndex++)
+	{
+		Bifrost::API::Component component = ss.components()[componentIndex];
+		if ( component.type() != Bifrost::API::PointComponentType )
+			continue;
+		int positionChannelIndex = findChannelIndexViaName(component,"position");
+		if (positionChannelIndex<0)
+			continue;
+		Bifrost::API::Channel position_ch = component.channels()[positionChannelIndex];
+		Bifrost::API::Channel velocity_ch;
+		int velocityChannelIndex = findChannelIndexViaName(component,"velocity");
+		if (i_velocityPadding != 0.0f && velocityChannelIndex>=0)
+			velocity_ch = component.channels()[velocityChannelIndex];
+		const bool padVelocity = velocity_ch.valid() && velocity_ch.dataType() == Bifrost::API::FloatV3Type;
+
+		Bifrost::API::Layout layout = component.layout();
+		Bifrost::API::TileAccessor accessor = layout.tileAccessor();
+		const float voxel_scale = layout.voxelScale();
+		size_t depthCount = layout.depthCount();
+		for ( size_t d=0; d<depthCount; d++ ) {
+			size_t tcount = layout.tileCount(d);
+			const size_t clusterSize = i_tilesPerCluster ? i_tilesPerCluster : std::max<size_t>(tcount,1);
+			for ( size_t clusterBegin=0; clusterBegin<tcount; clusterBegin+=clusterSize ) {
+				RenderTileCluster cluster;
+				cluster.componentIndex = componentIndex;
+				cluster.tileDepth = d;
+				cluster.tileIndex = clusterBegin;
+				cluster.tileCount = std::min(clusterSize, tcount - clusterBegin);
+				bool occupied = false;
+				float maxSpeed = 0.0f;
+				for ( size_t t=clusterBegin; t<clusterBegin+cluster.tileCount; t++ ) {
+					Bifrost::API::TreeIndex tindex(t,d);
+					if ( !position_ch.elementCount( tindex ) ) {
+						// nothing there
+						continue;
+					}
+					amino::Math::vec3f tileMin, tileMax;
+					tile_world_bounds(accessor.tile(tindex).info(),voxel_scale,tileMin,tileMax);
+					cluster.bbox.expand(MPoint(tileMin[0],tileMin[1],tileMin[2]));
+					cluster.bbox.expand(MPoint(tileMax[0],tileMax[1],tileMax[2]));
+					occupied = true;
+					if (padVelocity)
+					{
+						const Bifrost::API::TileData<amino::Math::vec3f>& velocity_tile_data = velocity_ch.tileData<amino::Math::vec3f>( tindex );
+						for (size_t i=0;i<velocity_tile_data.count();i++)
+						{
+							const amino::Math::vec3f& v = velocity_tile_data[i];
+							maxSpeed = std::max(maxSpeed, v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+						}
+					}
+				}
+				if (!occupied)
+					continue;
+				const double padding = sqrt(maxSpeed) * fabs(i_velocityPadding) + i_pointRadius;
+				const MPoint bmin = cluster.bbox.min();
+				const MPoint bmax = cluster.bbox.max();
+				cluster.bbox.expand(MPoint(bmin.x-padding,bmin.y-padding,bmin.z-padding));
+				cluster.bbox.expand(MPoint(bmax.x+padding,bmax.y+padding,bmax.z+padding));
+				o_clusters.push_back(cluster);
+			}
+		}
+	}
+	return true;
+}
+
+/*!
+ * \brief Same clusters as above from the point tiles recorded when the
+ *        loader decoded the file for rendering, so that nothing is read on
+ *        the main thread
+ */
+void computeRenderTileClusters(const BifrostFrameData& i_frame,
+							   size_t i_tilesPerCluster,
+							   float i_velocityPadding,
+							   float i_pointRadius,
+							   RenderTileClusterContainer& o_clusters)
+{
+	o_clusters.clear();
+	std::vector<float> clusterSpeeds;
+	for (size_t i=0;i<i_frame._pointTiles.size();i++)
+	{
+		const BifrostPointTile& tile = i_frame._pointTiles[i];
+		// Tiles are recorded in tree order, a cluster only gathers consecutive ones
+		const size_t clusterBegin = i_tilesPerCluster ? tile._tileIndex - tile._tileIndex % i_tilesPerCluster : 0;
+		if (o_clusters.empty()
+			|| o_clusters.back().componentIndex != tile._componentIndex
+			|| o_clusters.back().tileDepth != tile._tileDepth
+			|| o_clusters.back().tileIndex != clusterBegin)
+		{
+			RenderTileCluster cluster;
+			cluster.componentIndex = tile._componentIndex;
+			cluster.tileDepth = tile._tileDepth;
+			cluster.tileIndex = clusterBegin;
+			cluster.tileCount = i_tilesPerCluster;
+			o_clusters.push_back(cluster);
+			clusterSpeeds.push_back(0.0f);
+		}
+		RenderTileCluster& cluster = o_clusters.back();
+		if (!i_tilesPerCluster)
+			cluster.tileCount = tile._tileIndex + 1;
+		cluster.bbox.expand(MPoint(tile._bounds[0],tile._bounds[1],tile._bounds[2]));
+		cluster.bbox.expand(MPoint(tile._bounds[3],tile._bounds[4],tile._bounds[5]));
+		clusterSpeeds.back() = std::max(clusterSpeeds.back(), tile._maxSpeed);
+	}
+	for (size_t i=0;i<o_clusters.size();i++)
+	{
+		RenderTileCluster& cluster = o_clusters[i];
+		const double padding = clusterSpeeds[i] * fabs(i_velocityPadding) + i_pointRadius;
+		const MPoint bmin = cluster.bbox.min();
+		const MPoint bmax = cluster.bbox.max();
+		cluster.bbox.expand(MPoint(bmin.x-padding,bmin.y-padding,bmin.z-padding));
+		cluster.bbox.expand(MPoint(bmax.x+padding,bmax.y+padding,bmax.z+padding));
+	}
+}
+
+/*! \brief Largest distance of a sample time to a whole frame still taken as that frame */
+const double WHOLE_FRAME_TOLERANCE = 1.0e-4;
+
+/*!
+ * \brief Whether the motion samples can be emitted as a motion block of
+ *        the points of their files matched by id
+ *
+ * Each sample time is resolved to the file of a whole frame, so the block
+ * is only correct when every sample time is a whole frame, sub-frame
+ * samples are left to the velocity blur of the procedural. Needs at least
+ * two different frames, all with every point decoded and the same ids, so
+ * frames where points were born or died also fall back to velocity blur.
+ */
+bool canEmitPointMotionBlock(const BifrostSurfaceShape::MotionSampleContainer& i_samples)
+{
+	if (i_samples.size() < 2)
+		return false;
+	const BifrostFrameDataConstPtr& first = i_samples.begin()->second;
+	bool distinctFrames = false;
+	for (BifrostSurfaceShape::MotionSampleContainer::const_iterator iter = i_samples.begin(); iter != i_samples.end(); ++iter)
+	{
+		if (fabs(iter->first - floor(iter->first + 0.5)) > WHOLE_FRAME_TOLERANCE)
+			return false;
+		const BifrostFrameDataConstPtr& frame = iter->second;
+		if (!frame->_hasParticleIds || frame->_particleIds.size() != first->_particleIds.size())
+			return false;
+		if (frame != first)
+			distinctFrames = true;
+	}
+	if (!distinctFrames)
+		return false;
+
+	BifrostFrameData::IdVector firstSortedIds;
+	const BifrostFrameData* previousFrame = 0;
+	for (BifrostSurfaceShape::MotionSampleContainer::const_iterator iter = i_samples.begin(); iter != i_samples.end(); ++iter)
+	{
+		const BifrostFrameData& frame = *iter->second;
+		if (&frame == previousFrame)
+			continue;
+		previousFrame = &frame;
+		BifrostFrameData::IdVector sortedIds(frame._particleIds);
+		std::sort(sortedIds.begin(),sortedIds.end());
+		if (firstSortedIds.empty())
+			firstSortedIds.swap(sortedIds);
+		else if (sortedIds != firstSortedIds)
+			return false;
+	}
+	return true;
+}
+
 MStringArray BifrostSurfaceShapeCacheCommand::m_CachedShapeNames;
 MObject BifrostSurfaceShapeCacheCommand::m_CurrentBifrostSurfaceShape;
 
@@ -154,7 +367,7 @@ MStatus BifrostSurfaceShapeCacheCommand::parseSyntax (MArgDatabase &argData)
 		CMS(BifrostSurfaceShape* pBifrostSS = static_cast<BifrostSurfaceShape*>(nodeFn.userNode(&status)));
 		if (pBifrostSS) {
 			pBifrostSS->update();
-			pBifrostSS->accumulateMotionData();
+			pBifrostSS->accumulateMotionData(sampleTime);
 		}
 
 	}
@@ -170,6 +383,7 @@ MStatus BifrostSurfaceShapeCacheCommand::parseSyntax (MArgDatabase &argData)
 				break;
 			}
 		}
+		clearMotionData(shapeName);
 	}
 
 	if (argData.isFlagSet(Emit_Flag_ShortName)) {
@@ -203,7 +417,7 @@ MStatus BifrostSurfaceShapeCacheCommand::parseSyntax (MArgDatabase &argData)
 		CMS(MPlug empTimePlug = nodeFn.findPlug(empTimeAttrName,true,&status));
 		MTime empTimeValue;
 		CMS(status = empTimePlug.getValue(empTimeValue));
-		int frameNumber = static_cast<int>(ceil(empTimeValue.as( empTimeValue.uiUnit() )));
+		int frameNumber = BifrostSurfaceShape::frameNumber(empTimeValue);
 		{
 			char buf[BUFSIZ];
 			sprintf(buf,"Bifrost CacheCommand Procedural frame number = %d, animation time = %f",
@@ -212,7 +426,10 @@ MStatus BifrostSurfaceShapeCacheCommand::parseSyntax (MArgDatabase &argData)
 			MGlobal::displayInfo(buf);
 		}
 		char numberedFrameBifrostFilePath[2048];
-		sprintf(numberedFrameBifrostFilePath,empFilePath.asChar(),frameNumber);
+		strncpy(numberedFrameBifrostFilePath,
+				BifrostSurfaceShape::frameFilePath(empFilePath,frameNumber).c_str(),
+				sizeof(numberedFrameBifrostFilePath)-1);
+		numberedFrameBifrostFilePath[sizeof(numberedFrameBifrostFilePath)-1] = '\0';
 		MGlobal::displayInfo(MString("BifrostSurfaceShapeCacheCommand : Emit RiAttributeBegin"));
 
 		/*
@@ -250,61 +467,122 @@ MStatus BifrostSurfaceShapeCacheCommand::parseSyntax (MArgDatabase &argData)
 			MGlobal::displayInfo(buf);
 		}
 
+		// Tiles per emitted procedural, 0 emits the whole file as one procedural
+		MString empTileClusterAttrName("renderTileCluster");
+		CMS(MPlug empTileClusterPlug = nodeFn.findPlug(empTileClusterAttrName,true,&status));
+		int empTileClusterValue;
+		CMS(status = empTileClusterPlug.getValue(empTileClusterValue));
+
+		// Velocity keys are within a frame of the sample, pad the bounds by a frame of motion
+		const float fps = static_cast<float>(1.0 / MTime(1.0, MTime::uiUnit()).as(MTime::kSeconds));
+		const float velocityPadding = empVelocityBlurValue ? 1.0f / fps : 0.0f;
+
+		// Motion samples accumulated by -addstep, the file is not read again
+		// when they can be emitted as a motion block
+		const BifrostSurfaceShape::MotionSampleContainer& motionSamples = pBifrostSS->motionSamples();
+		BifrostFrameDataConstPtr sampleFrame = motionSamples.empty() ? BifrostFrameDataConstPtr() : motionSamples.begin()->second;
+		const bool motionBlock = canEmitPointMotionBlock(motionSamples);
+		RenderTileClusterContainer clusters;
+		if (!motionBlock)
+		{
+			// Reuse the tiles of a frame already decoded for rendering, the
+			// file is only read here when none of them is the emitted one
+			const size_t tilesPerCluster = empTileClusterValue > 0 ? size_t(empTileClusterValue) : 0;
+			BifrostFrameDataConstPtr tileFrame;
+			if (sampleFrame && sampleFrame->_hasPointTiles && sampleFrame->_filename == numberedFrameBifrostFilePath)
+				tileFrame = sampleFrame;
+			else
+			{
+				BifrostFrameDataConstPtr latestFrame = pBifrostSS->latestFrame();
+				if (latestFrame && latestFrame->_hasPointTiles && latestFrame->_filename == numberedFrameBifrostFilePath)
+					tileFrame = latestFrame;
+			}
+			if (tileFrame)
+				computeRenderTileClusters(*tileFrame,
+										  tilesPerCluster,
+										  velocityPadding,
+										  RENDER_POINT_RADIUS,
+										  clusters);
+			else
+				computeRenderTileClusters(numberedFrameBifrostFilePath,
+										  tilesPerCluster,
+										  velocityPadding,
+										  RENDER_POINT_RADIUS,
+										  clusters);
+		}
+
 		// Build the DSO arguments with the input parameter values
-		sprintf(dsoArgs,"--emp_file %s "
-				// "--width %f "
-				"--velocity_blur %d --chunk_size %d",
+		sprintf(dsoArgs,"%s --fps %f --point-radius %f%s",
 				numberedFrameBifrostFilePath,
-				// empWidthValue,
-				empVelocityBlurValue?1:0,
-				empChunkValue);
+				fps,
+				RENDER_POINT_RADIUS,
+				empVelocityBlurValue ? "" : " --no-velocity-blur");
 
 		CMS(status = MGlobal::executeCommand( "RiAttributeBegin;"));
-		bool hasGeometry = pBifrostSS->hasGeometryData();
-		if (hasGeometry)
+		bool hasGeometry = motionBlock || !clusters.empty() || (sampleFrame ? !sampleFrame->_bm.empty() : pBifrostSS->hasGeometryData());
+		if (motionBlock)
+		{
+			// Whole frame samples with the same points, one key per sample
+			CMS(status = MGlobal::executeCommand( "RiArchiveRecord -mode \"comment\" -text \"CustomSurfaceShapeCacheCommand emit motion block begins\";"));
+			CMS(status = MGlobal::executeCommand( "RiReverseOrientation;"));
+			// The procedural reads and matches the points of the sample files itself
+			std::string motionArgs(dsoArgs);
+			MBoundingBox bbox;
+			for (BifrostSurfaceShape::MotionSampleContainer::const_iterator iter = motionSamples.begin(); iter != motionSamples.end(); ++iter)
+			{
+				motionArgs += (boost::format(" --motion-sample-time %1% --motion-sample-file %2%") % iter->first % iter->second->_filename).str();
+				bbox.expand(iter->second->_particleBBox);
+			}
+			const double padding = RENDER_POINT_RADIUS;
+			const std::string proceduralCommand = (boost::format("RiProcedural -libraryName bifrost -bound %1% %2% %3% %4% %5% %6% -param \"%7%\";")
+												   % (bbox.min().x - padding) % (bbox.max().x + padding)
+												   % (bbox.min().y - padding) % (bbox.max().y + padding)
+												   % (bbox.min().z - padding) % (bbox.max().z + padding)
+												   % motionArgs).str();
+			CMS(status = MGlobal::executeCommand( proceduralCommand.c_str() ));
+		}
+		else if (hasGeometry)
 		{
 			CMS(status = MGlobal::executeCommand( "RiArchiveRecord -mode \"comment\" -text \"CustomSurfaceShapeCacheCommand emit command begins\";"));
 			CMS(status = MGlobal::executeCommand( "RiReverseOrientation;"));
-			bool RIUseRunProgram = true;
-			RtString data[2] = {"CustomProcedural",dsoArgs};
-			RtBound bound = {-RI_INFINITY,RI_INFINITY,
-							 -RI_INFINITY,RI_INFINITY,
-							 -RI_INFINITY,RI_INFINITY};
-			RtString procedural_data[2] = {"emp_runproc",dsoArgs};
-			RtString program_data[2] = {"emp_runprog",dsoArgs};
 			char proceduralCommandString[BUFSIZ];
-			if (RIUseRunProgram)
+			if (empTileClusterValue <= 0)
 			{
+				// Single procedural, it splits the file in tile clusters itself
+				MBoundingBox bbox;
+				for (size_t i=0;i<clusters.size();i++)
+					bbox.expand(clusters[i].bbox);
+				if (clusters.empty())
+					bbox = pBifrostSS->boundingBox();
 				sprintf(proceduralCommandString,
-						"RiProcedural -programName emp_runprog -bound %f %f %f %f %f %f -param \"%s\";",
-						bound[0],
-						bound[1],
-						bound[2],
-						bound[3],
-						bound[4],
-						bound[5],
-						dsoArgs
-						);
-				MGlobal::displayInfo(proceduralCommandString);
-				MGlobal::executeCommand( proceduralCommandString );
+						"RiProcedural -libraryName bifrost -bound %f %f %f %f %f %f -param \"%s\";",
+						bbox.min().x, bbox.max().x,
+						bbox.min().y, bbox.max().y,
+						bbox.min().z, bbox.max().z,
+						dsoArgs);
+				CMS(status = MGlobal::executeCommand( proceduralCommandString ));
 			}
 			else
 			{
-				sprintf(proceduralCommandString,
-						"RiProcedural -libraryName emp_runproc -bound %f %f %f %f %f %f -param \"%s\";",
-						bound[0],
-						bound[1],
-						bound[2],
-						bound[3],
-						bound[4],
-						bound[5],
-						dsoArgs
-						);
-				MGlobal::displayInfo(proceduralCommandString);
-				MGlobal::executeCommand( proceduralCommandString );
+				// One procedural per tile cluster so the renderer culls them one by one
+				for (size_t i=0;i<clusters.size();i++)
+				{
+					const RenderTileCluster& cluster = clusters[i];
+					sprintf(proceduralCommandString,
+							"RiProcedural -libraryName bifrost -bound %f %f %f %f %f %f -param \"%s --component %lu --tile-depth %lu --tile-index %lu --tile-count %lu\";",
+							cluster.bbox.min().x, cluster.bbox.max().x,
+							cluster.bbox.min().y, cluster.bbox.max().y,
+							cluster.bbox.min().z, cluster.bbox.max().z,
+							dsoArgs,
+							static_cast<unsigned long>(cluster.componentIndex),
+							static_cast<unsigned long>(cluster.tileDepth),
+							static_cast<unsigned long>(cluster.tileIndex),
+							static_cast<unsigned long>(cluster.tileCount));
+					CMS(status = MGlobal::executeCommand( proceduralCommandString ));
+				}
 			}
 		}
-		bool hasField = pBifrostSS->hasFieldData();
+		bool hasField = sampleFrame ? !sampleFrame->_bf.empty() : pBifrostSS->hasFieldData();
 		if (hasField)
 		{
 			char RiInteriorCommandString[BUFSIZ];
@@ -375,6 +653,9 @@ MStatus BifrostSurfaceShapeCacheCommand::parseSyntax (MArgDatabase &argData)
 		MGlobal::displayInfo("Flush cached shapenames and shapenodes");
 		std::cout << "BifrostSurfaceShapeCacheCommand : Flush cached shapenames and shapenodes" << std::endl;
 
+		for (unsigned int i=0;i<m_CachedShapeNames.length();i++) {
+			clearMotionData(m_CachedShapeNames[i]);
+		}
 		CMS(status = m_CachedShapeNames.clear());
 
 	}
@@ -416,3 +697,18 @@ bool BifrostSurfaceShapeCacheCommand::isCached (MString &shapeName)
 void BifrostSurfaceShapeCacheCommand::emitShader (MString &baseDirectory)
 {
 }
+
+void BifrostSurfaceShapeCacheCommand::clearMotionData (const MString &shapeName)
+{
+	MStatus status;
+	MSelectionList selectionList;
+	MObject node;
+	if (selectionList.add(shapeName) != MS::kSuccess || selectionList.getDependNode(0,node) != MS::kSuccess)
+		return;
+	MFnDependencyNode nodeFn(node,&status);
+	if (status != MS::kSuccess || nodeFn.typeName() != "BifrostSurfaceShape")
+		return;
+	BifrostSurfaceShape* pBifrostSS = static_cast<BifrostSurfaceShape*>(nodeFn.userNode(&status));
+	if (pBifrostSS)
+		pBifrostSS->clearMotionData();
+}
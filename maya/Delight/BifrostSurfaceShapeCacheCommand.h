@@ -42,6 +42,8 @@ private:
     MStatus parseSyntax (MArgDatabase &argData);
     bool isCached (MString &shapeName);
     void emitShader(MString &baseDirectory);
+    /*! \brief Release the motion samples accumulated by a shape */
+    void clearMotionData(const MString &shapeName);
     static MStringArray m_CachedShapeNames;
     static MObject m_CurrentBifrostSurfaceShape;
 };
@@ -1,7 +1,9 @@
 #include "BifrostSurfaceShape.h"
 #include "BifrostSurfaceShapeUI.h"
 #include "BifrostSurfaceShapeCacheCommand.h"
+#include "BifrostGeometryOverride.h"
 #include <maya/MFnPlugin.h>
+#include <maya/MDrawRegistry.h>
 #include "MayaUtils.h"
 #include <boost/format.hpp>
 
@@ -15,11 +17,17 @@ MStatus initializePlugin( MObject obj )
                     "Procedural Insight Pty. Ltd. info@procedualinsight.com",
 					version_format.str().c_str(),
                     "Any");
+  MString drawDbClassification(BifrostGeometryOverride::drawDbClassification);
   CMS(status = plugin.registerShape( "BifrostSurfaceShape",
                                      BifrostSurfaceShape::typeId,
                                      &BifrostSurfaceShape::creator,
                                      &BifrostSurfaceShape::initialize,
-                                     &BifrostSurfaceShapeUI::creator));
+                                     &BifrostSurfaceShapeUI::creator,
+                                     &drawDbClassification));
+
+  CMS(status = MHWRender::MDrawRegistry::registerGeometryOverrideCreator( drawDbClassification,
+                                                                        BifrostGeometryOverride::drawRegistrantId,
+                                                                        &BifrostGeometryOverride::creator));
 
   CMS(status = plugin.registerCommand("BifrostSurfaceShapeCache",
                                       &BifrostSurfaceShapeCacheCommand::creator,
@@ -44,6 +52,8 @@ MStatus uninitializePlugin( MObject obj)
   MStatus status;
   int lic_status = 0;
   MFnPlugin plugin( obj );
+  status = MHWRender::MDrawRegistry::deregisterGeometryOverrideCreator( BifrostGeometryOverride::drawDbClassification,
+                                                                      BifrostGeometryOverride::drawRegistrantId );
   status = plugin.deregisterNode( BifrostSurfaceShape::typeId );
   
   return status;
@@ -1,5 +1,6 @@
 #include "ProcArgs.h"
 #include <boost/program_options.hpp>
+#include <algorithm>
 
 namespace po = boost::program_options;
 
@@ -7,11 +8,25 @@ ProcArgs::ProcArgs()
 : proceduralNode(0)
 , velocityScale(1.0f)
 , pointRadius(0.01f)
+, radiusScale(1.0f)
+, maxRadius(0.0f)
+, maxSpeed(0.0f)
+, densityFraction(1.0f)
+, lodDistance(0.0f)
+, lodMinPixelRadius(0.0f)
+, lodMinFraction(0.001f)
+, tileFraction(1.0f)
 , pointMode(0) // default is disk = 0, sphere = 1, quad = 2
 , enableVelocityMotionBlur(false)
+, motionKeys(2)
+, motionStart(0.0f)
+, motionEnd(1.0f)
+, useAdjacentFrames(false)
 , performEmission(false)
 , bifrostTileIndex(0)
 , bifrostTileDepth(0)
+, bifrostTileCount(1)
+, tilesPerProcedural(1)
 {
 }
 
@@ -21,9 +36,24 @@ int ProcArgs::processDataStringAsArgcArgv(int argc, const char **argv)
         float vScale = 1.0f;
         float radius = 0.01f; // default - renders point of size 0.01
         size_t mode = 0; // default - disk
+        std::string radius_channel;
+        float rScale = 1.0f;
+        float max_radius = 0.0f;
+        float max_speed = 0.0f;
+        std::vector<std::string> user_data_channels;
+        float density_fraction = 1.0f;
+        float lod_distance = 0.0f;
+        float lod_min_pixel_radius = 0.0f;
+        float lod_min_fraction = 0.001f;
+        float tile_fraction = 1.0f;
         std::string bifrost_filename;
         size_t tileIndex = 0;
         size_t tileDepth = 0;
+        size_t tileCount = 1;
+        size_t motion_keys = 2;
+        float motion_start = 0.0f;
+        float motion_end = 1.0f;
+        size_t tileCluster = 1;
         po::options_description desc("Allowed options");
         desc.add_options()
             ("version", "print version string")
@@ -34,13 +64,44 @@ int ProcArgs::processDataStringAsArgcArgv(int argc, const char **argv)
              "radius for Arnold point geometry.")
             ("point-mode", po::value<size_t>(&mode),
              "mode for Arnold point geometry.")
+            ("radius-channel", po::value<std::string>(&radius_channel),
+             "bifrost channel providing per point radius.")
+            ("radius-scale", po::value<float>(&rScale),
+             "scale applied to the radius channel values.")
+            ("max-radius", po::value<float>(&max_radius),
+             "root level, upper bound of the radius channel values used to pad the tile bounds.")
+            ("max-speed", po::value<float>(&max_speed),
+             "root level, upper bound of the point speed used to pad the tile bounds for motion blur.")
+            ("user-data", po::value<std::vector<std::string> >(&user_data_channels)->composing(),
+             "bifrost channel exported as points user data, may be repeated.")
+            ("density-fraction", po::value<float>(&density_fraction),
+             "fraction of the points to render, radius is scaled to preserve coverage.")
+            ("lod-distance", po::value<float>(&lod_distance),
+             "camera distance beyond which points are decimated, 0 disables.")
+            ("lod-pixel-radius", po::value<float>(&lod_min_pixel_radius),
+             "projected point radius in pixels under which points are decimated, 0 disables.")
+            ("lod-min-fraction", po::value<float>(&lod_min_fraction),
+             "lower bound of the fraction of points kept per tile.")
+            ("tile-fraction", po::value<float>(&tile_fraction),
+             "non-root level, fraction of the tile points to emit.")
             ("velocity-blur", "use velocity for motion blur.")
+            ("motion-keys", po::value<size_t>(&motion_keys),
+             "number of motion keys over the motion range.")
+            ("motion-start", po::value<float>(&motion_start),
+             "start of the motion range the scene was exported with, in frames relative to the current frame.")
+            ("motion-end", po::value<float>(&motion_end),
+             "end of the motion range the scene was exported with, in frames relative to the current frame.")
+            ("adjacent-frames", "motion keys follow the points of the previous and next frames matched by id64.")
             ("bif", po::value<std::string>(&bifrost_filename),
              "bifrost filename.")
             ("tile-index", po::value<size_t>(&tileIndex),
              "bifrost tile index.")
             ("tile-depth", po::value<size_t>(&tileDepth),
              "bifrost tile depth.")
+            ("tile-count", po::value<size_t>(&tileCount),
+             "number of consecutive bifrost tiles from tile-index to emit.")
+            ("tile-cluster", po::value<size_t>(&tileCluster),
+             "number of bifrost tiles per child procedural.")
             ("emit", "non-root level, perform emission.")
             ;
 
@@ -55,16 +116,34 @@ int ProcArgs::processDataStringAsArgcArgv(int argc, const char **argv)
         if (vm.count("velocity-blur")) {
             enableVelocityMotionBlur = true;
         }
+        if (vm.count("adjacent-frames")) {
+            useAdjacentFrames = true;
+        }
         if (vm.count("emit")) {
             performEmission = true;
         }
         velocityScale = vScale;
         pointRadius = radius;
         pointMode = mode;
+        motionKeys = motion_keys > 0 ? motion_keys : 1;
+        motionStart = motion_start;
+        motionEnd = motion_end;
+        radiusChannelName = radius_channel;
+        radiusScale = rScale;
+        maxRadius = std::max(max_radius,0.0f);
+        maxSpeed = std::max(max_speed,0.0f);
+        userDataChannelNames = user_data_channels;
+        densityFraction = std::min(std::max(density_fraction,0.0f),1.0f);
+        lodDistance = lod_distance;
+        lodMinPixelRadius = lod_min_pixel_radius;
+        lodMinFraction = std::min(std::max(lod_min_fraction,0.0f),1.0f);
+        tileFraction = std::min(std::max(tile_fraction,0.0f),1.0f);
         bifrostFilename = bifrost_filename;
         // std::cout << "XXXXXXXXXXXXXX bifrost_filename : " << bifrost_filename << std::endl;
         bifrostTileIndex = tileIndex;
         bifrostTileDepth = tileDepth;
+        bifrostTileCount = tileCount;
+        tilesPerProcedural = tileCluster > 0 ? tileCluster : 1;
     }
     catch(std::exception& e) {
         std::cerr << "error: " << e.what() << "\n";
@@ -80,8 +159,23 @@ void ProcArgs::print() const
 {
     printf("pointRadius              = %f\n",pointRadius);
     printf("enableVelocityMotionBlur = %s\n",(enableVelocityMotionBlur?"true":"false"));
+    printf("motionKeys               = %zu\n",motionKeys);
+    printf("motionStart              = %f\n",motionStart);
+    printf("motionEnd                = %f\n",motionEnd);
+    printf("useAdjacentFrames        = %s\n",(useAdjacentFrames?"true":"false"));
     printf("performEmission          = %s\n",(performEmission?"true":"false"));
+    printf("radiusChannelName        = %s\n",radiusChannelName.c_str());
+    printf("radiusScale              = %f\n",radiusScale);
+    printf("maxRadius                = %f\n",maxRadius);
+    printf("maxSpeed                 = %f\n",maxSpeed);
+    printf("userDataChannelNames     = %zu\n",userDataChannelNames.size());
+    printf("densityFraction          = %f\n",densityFraction);
+    printf("lodDistance              = %f\n",lodDistance);
+    printf("lodMinPixelRadius        = %f\n",lodMinPixelRadius);
+    printf("tileFraction             = %f\n",tileFraction);
     printf("bifrostFilename          = %s\n",bifrostFilename.c_str());
     printf("bifrostTileIndex         = %zu\n",bifrostTileIndex);
     printf("bifrostTileDepth         = %zu\n",bifrostTileDepth);
+    printf("bifrostTileCount         = %zu\n",bifrostTileCount);
+    printf("tilesPerProcedural       = %zu\n",tilesPerProcedural);
 }
@@ -17,12 +17,31 @@ struct ProcArgs {
     AtNodePtrContainer createdNodes;
     float velocityScale;
     float pointRadius;
+    std::string radiusChannelName; //!< per point radius channel, constant pointRadius if empty
+    float radiusScale;
+    float maxRadius; //!< upper bound of the radius channel values padding the child bounds, 0 uses pointRadius
+    float maxSpeed; //!< upper bound of the point speed padding the child bounds for motion blur
+    std::vector<std::string> userDataChannelNames; //!< FloatType/FloatV3Type channels exported as user data
+    float densityFraction; //!< fraction of the points kept before the camera based metrics
+    float lodDistance; //!< camera distance beyond which points are thinned out, 0 disables
+    float lodMinPixelRadius; //!< projected radius under which points are thinned out, 0 disables
+    float lodMinFraction;
+    float tileFraction; //!< fraction of points emitted, computed by the root procedural
     size_t pointMode;
     bool enableVelocityMotionBlur;
+    size_t motionKeys; //!< number of motion keys spread over the motion range
+    float motionStart; //!< motion range start in frames relative to the current frame
+    float motionEnd;
+    bool useAdjacentFrames; //!< motion keys follow the id64 matched points of the adjacent frames
     bool performEmission;
     std::string bifrostFilename;
+    std::string cachedBifrostFilename; //!< resolved filename held in ProcCache, empty if none
+    std::string cachedPreviousFrameFilename;
+    std::string cachedNextFrameFilename;
     size_t bifrostTileIndex;
     size_t bifrostTileDepth;
+    size_t bifrostTileCount;
+    size_t tilesPerProcedural;
     int processDataStringAsArgcArgv(int argc, const char **argv);
     void print() const;
 };
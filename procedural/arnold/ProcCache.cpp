@@ -0,0 +1,100 @@
+#include "ProcCache.h"
+#include <utils/BifrostUtils.h>
+
+std::mutex ProcCache::_mutex;
+ProcCache::EntryContainer ProcCache::_entries;
+
+Bifrost::API::StateServer ProcCache::acquire(const std::string& i_bif_filename)
+{
+    EntryPtr entry;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        EntryPtr& slot = _entries[i_bif_filename];
+        if (!slot)
+            slot.reset(new Entry);
+        slot->refCount++;
+        entry = slot;
+    }
+
+    /*!
+     * \remark The cache lock is not held while loading, concurrent child
+     *         procedurals referring to the same file wait for the single
+     *         load of its entry, other files load in parallel
+     */
+    std::call_once(entry->loaded, [&entry, &i_bif_filename]()
+    {
+        Bifrost::API::String biffile = i_bif_filename.c_str();
+        entry->fileio = entry->om.createFileIO( biffile );
+        entry->ss = entry->fileio.load( );
+    });
+    if ( !entry->ss.valid() ) {
+        release(i_bif_filename);
+        return Bifrost::API::StateServer();
+    }
+    return entry->ss;
+}
+
+void ProcCache::release(const std::string& i_bif_filename)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    EntryContainer::iterator iter = _entries.find(i_bif_filename);
+    if (iter == _entries.end())
+        return;
+    if (--iter->second->refCount == 0)
+        _entries.erase(iter);
+}
+
+ProcCache::EntryPtr ProcCache::find(const std::string& i_bif_filename)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    EntryContainer::iterator iter = _entries.find(i_bif_filename);
+    return iter == _entries.end() ? EntryPtr() : iter->second;
+}
+
+const ProcCache::IdPositionMap* ProcCache::idPositions(const std::string& i_bif_filename)
+{
+    EntryPtr entryPtr = find(i_bif_filename);
+    if (!entryPtr || !entryPtr->ss.valid())
+        return 0;
+    Entry& entry = *entryPtr;
+    std::call_once(entry.idPositionsBuilt, [&entry]()
+    {
+        size_t numComponents = entry.ss.components().count();
+        for (size_t componentIndex=0;componentIndex<numComponents;componentIndex++)
+        {
+            Bifrost::API::Component component = entry.ss.components()[componentIndex];
+            if (component.type() != Bifrost::API::PointComponentType)
+                continue;
+            int positionChannelIndex = findChannelIndexViaName(component,"position");
+            int idChannelIndex = findChannelIndexViaName(component,"id64");
+            if (positionChannelIndex<0 || idChannelIndex<0)
+                continue;
+            Bifrost::API::Channel position_ch = component.channels()[positionChannelIndex];
+            Bifrost::API::Channel id_ch = component.channels()[idChannelIndex];
+            if (position_ch.dataType() != Bifrost::API::FloatV3Type || id_ch.dataType() != Bifrost::API::UInt64Type)
+                continue;
+            Bifrost::API::Layout layout = component.layout();
+            const float voxelScale = layout.voxelScale();
+            entry.idPositions.reserve(entry.idPositions.size() + component.elementCount());
+            size_t depthCount = layout.depthCount();
+            for ( size_t d=0; d<depthCount; d++ ) {
+                for ( size_t t=0; t<layout.tileCount(d); t++ ) {
+                    Bifrost::API::TreeIndex tindex(t,d);
+                    if ( !position_ch.elementCount( tindex ) ) {
+                        // nothing there
+                        continue;
+                    }
+                    const Bifrost::API::TileData<amino::Math::vec3f>& position_tile_data = position_ch.tileData<amino::Math::vec3f>( tindex );
+                    const Bifrost::API::TileData<uint64_t>& id_tile_data = id_ch.tileData<uint64_t>( tindex );
+                    for (size_t i=0; i<position_tile_data.count() && i<id_tile_data.count(); i++ ) {
+                        amino::Math::vec3f& position = entry.idPositions[id_tile_data[i]];
+                        position[0] = voxelScale * position_tile_data[i][0];
+                        position[1] = voxelScale * position_tile_data[i][1];
+                        position[2] = voxelScale * position_tile_data[i][2];
+                    }
+                }
+            }
+        }
+    });
+    return entry.idPositions.empty() ? 0 : &(entry.idPositions);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <stdint.h>
+
+// Bifrost headers - START
+#include <bifrostapi/bifrost_om.h>
+#include <bifrostapi/bifrost_stateserver.h>
+#include <bifrostapi/bifrost_fileio.h>
+#include <bifrostapi/bifrost_types.h>
+// Bifrost headers - END
+
+/*!
+ * \brief Process wide cache of loaded Bifrost files shared by all the
+ *        procedural instances of a render session
+ * \note Entries are reference counted, each successful acquire() must be
+ *       matched by a release() of the same filename, the state server is
+ *       dropped when the last user releases it
+ */
+class ProcCache {
+public:
+    typedef std::unordered_map<uint64_t,amino::Math::vec3f> IdPositionMap;
+    /*!
+     * \brief Return the state server for the resolved filename, loading the
+     *        file on first use, the returned state server is invalid if
+     *        the load failed in which case no reference is held
+     * \remark Only callers of the same file wait for its load, files are
+     *         loaded concurrently
+     */
+    static Bifrost::API::StateServer acquire(const std::string& i_bif_filename);
+    static void release(const std::string& i_bif_filename);
+    /*!
+     * \brief World space positions of the points of an acquired file keyed
+     *        by their id64 channel value, built on first request and kept
+     *        until the file is released, null if the file has no id64 channel
+     */
+    static const IdPositionMap* idPositions(const std::string& i_bif_filename);
+private:
+    struct Entry {
+        Entry() : refCount(0) {}
+        std::once_flag loaded;
+        Bifrost::API::ObjectModel om;
+        Bifrost::API::FileIO fileio;
+        Bifrost::API::StateServer ss;
+        size_t refCount; //!< guarded by the cache mutex
+        std::once_flag idPositionsBuilt;
+        IdPositionMap idPositions;
+    };
+    typedef std::shared_ptr<Entry> EntryPtr;
+    typedef std::map<std::string,EntryPtr> EntryContainer;
+    static EntryPtr find(const std::string& i_bif_filename);
+    static std::mutex _mutex;
+    static EntryContainer _entries;
+};
@@ -1,7 +1,10 @@
 #include "ProcArgs.h"
+#include "ProcCache.h"
 #include <utils/BifrostUtils.h>
 #include <ai.h>
 #include <string.h>
+#include <algorithm>
+#include <mutex>
 #include <boost/format.hpp>
 #include <math.h>
 #include <String2ArgcArgv.h>
@@ -22,146 +25,679 @@
 
 const size_t MAX_BIF_FILENAME_LENGTH = 4096;
 
+/*!
+ * \brief Channels of a point component used to build the Arnold points
+ * \note radius is invalid when the constant point radius is used
+ */
+struct PointChannels {
+    PointChannels() : voxelScale(1.0f) {}
+    float voxelScale; //!< positions are stored in voxel space
+    Bifrost::API::Channel position;
+    Bifrost::API::Channel velocity;
+    Bifrost::API::Channel radius;
+    Bifrost::API::Channel id; //!< stable point identifier for the level of detail selection
+    std::vector<Bifrost::API::Channel> userData;
+};
+
+/*!
+ * \brief Locate the position channel, and the velocity channel when velocity
+ *        motion blur is requested, both must be of FloatV3Type. The optional
+ *        radius channel must be of FloatType, the user data channels of
+ *        FloatType or FloatV3Type, others are skipped with a warning
+ */
+bool GetPointChannels(const Bifrost::API::Component& component,
+                      const ProcArgs& args,
+                      PointChannels& channels)
+{
+    int positionChannelIndex = findChannelIndexViaName(component,"position");
+    int velocityChannelIndex = findChannelIndexViaName(component,"velocity");
+    if (positionChannelIndex<0 || (args.enableVelocityMotionBlur && velocityChannelIndex<0))
+    {
+        AiMsgWarning("Bifrost-procedural : Position channel not found or velocity channel not found where velocity motion blur is requested");
+        return false;
+    }
+    channels.position = component.channels()[positionChannelIndex];
+    channels.voxelScale = component.layout().voxelScale();
+    if (velocityChannelIndex>=0)
+        channels.velocity = component.channels()[velocityChannelIndex];
+    if ( channels.position.dataType() != Bifrost::API::FloatV3Type
+         ||
+         (args.enableVelocityMotionBlur?(channels.velocity.dataType() != Bifrost::API::FloatV3Type):false) // check conditionally
+         )
+    {
+        AiMsgWarning("Bifrost-procedural : Position channel not of FloatV3Type or velocity channel not of FloatV3Type where velocity motion blur is requested");
+        return false;
+    }
+    int idChannelIndex = findChannelIndexViaName(component,"id64");
+    if (idChannelIndex>=0)
+        channels.id = component.channels()[idChannelIndex];
+    if (!args.radiusChannelName.empty())
+    {
+        int radiusChannelIndex = findChannelIndexViaName(component,args.radiusChannelName.c_str());
+        if (radiusChannelIndex>=0)
+            channels.radius = component.channels()[radiusChannelIndex];
+        if (channels.radius.valid() && channels.radius.dataType() != Bifrost::API::FloatType)
+            channels.radius = Bifrost::API::Channel();
+        if (!channels.radius.valid())
+            AiMsgWarning("Bifrost-procedural : Radius channel \"%s\" not found or not of FloatType, using constant point radius",
+                         args.radiusChannelName.c_str());
+    }
+    for (size_t i=0; i<args.userDataChannelNames.size(); i++)
+    {
+        int userDataChannelIndex = findChannelIndexViaName(component,args.userDataChannelNames[i].c_str());
+        if (userDataChannelIndex<0)
+        {
+            AiMsgWarning("Bifrost-procedural : User data channel \"%s\" not found",
+                         args.userDataChannelNames[i].c_str());
+            continue;
+        }
+        Bifrost::API::Channel userData_ch = component.channels()[userDataChannelIndex];
+        if (userData_ch.dataType() != Bifrost::API::FloatType && userData_ch.dataType() != Bifrost::API::FloatV3Type)
+        {
+            AiMsgWarning("Bifrost-procedural : User data channel \"%s\" not of FloatType or FloatV3Type",
+                         args.userDataChannelNames[i].c_str());
+            continue;
+        }
+        channels.userData.push_back(userData_ch);
+    }
+    return true;
+}
+
+/*!
+ * \brief Name of the user data declared on the points node for a channel,
+ *        the Bifrost channel name stripped of its component prefix
+ */
+std::string UserDataName(const Bifrost::API::Channel& channel)
+{
+    return channel_short_name(channel.name().c_str());
+}
+
+/*!
+ * \brief Motion blur sampling shared by the tiles of a procedural
+ * \note Key times are in frames relative to the current frame, evenly
+ *       spread over the motion range as Arnold expects motion keys
+ */
+struct MotionContext {
+    MotionContext() : fps_1(1.0f/24.0f), previousFrame(0), nextFrame(0) {}
+    float fps_1;
+    std::vector<float> keyTimes;
+    const ProcCache::IdPositionMap* previousFrame; //!< null unless adjacent frame trajectories are used
+    const ProcCache::IdPositionMap* nextFrame;
+};
+
+/*!
+ * \brief Key times evenly spread over the motion range given by the
+ *        motionStart and motionEnd arguments, in frames relative to the
+ *        current frame, a single key at the current frame when velocity
+ *        motion blur is disabled
+ * \note Arnold spreads the keys of the created nodes evenly over the motion
+ *       range the scene was exported with, the camera shutter is relative
+ *       to that range and is not a frame offset
+ */
+void ComputeMotionKeyTimes(const ProcArgs& args, std::vector<float>& keyTimes)
+{
+    keyTimes.clear();
+    if (!args.enableVelocityMotionBlur || args.motionKeys < 2)
+    {
+        keyTimes.push_back(0.0f);
+        return;
+    }
+    float motionStart = args.motionStart;
+    float motionEnd = args.motionEnd;
+    if (motionEnd <= motionStart)
+    {
+        static std::once_flag emptyMotionRangeWarning;
+        std::call_once(emptyMotionRangeWarning, []()
+        {
+            AiMsgWarning("Bifrost-procedural : Motion end is not after motion start, velocity motion keys span one frame");
+        });
+        motionStart = 0.0f;
+        motionEnd = 1.0f;
+    }
+    for (size_t k=0; k<args.motionKeys; k++)
+        keyTimes.push_back(motionStart + (motionEnd - motionStart) * k / (args.motionKeys - 1));
+}
+
+/*!
+ * \brief World space positions of a point at the motion key times along the
+ *        quadratic through its previous, current and next frame positions
+ * \return false when the point is found in neither adjacent frame
+ */
+bool EvaluateAdjacentFrameKeys(const MotionContext& motion,
+                               uint64_t id,
+                               const Imath::V3f& P0,
+                               Imath::V3f* keys)
+{
+    ProcCache::IdPositionMap::const_iterator previous;
+    ProcCache::IdPositionMap::const_iterator next;
+    bool hasPrevious = motion.previousFrame && (previous = motion.previousFrame->find(id)) != motion.previousFrame->end();
+    bool hasNext = motion.nextFrame && (next = motion.nextFrame->find(id)) != motion.nextFrame->end();
+    if (!hasPrevious && !hasNext)
+        return false;
+    Imath::V3f Pm = hasPrevious ? Imath::V3f(previous->second[0],previous->second[1],previous->second[2]) : Imath::V3f();
+    Imath::V3f Pp = hasNext ? Imath::V3f(next->second[0],next->second[1],next->second[2]) : Imath::V3f();
+    // First and second derivative in frame units, one sided when a frame is missing
+    Imath::V3f d1;
+    Imath::V3f d2;
+    if (hasPrevious && hasNext)
+    {
+        d1 = 0.5f * (Pp - Pm);
+        d2 = Pp - 2.0f * P0 + Pm;
+    }
+    else
+        d1 = hasNext ? (Pp - P0) : (P0 - Pm);
+    for (size_t k=0; k<motion.keyTimes.size(); k++)
+    {
+        const float t = motion.keyTimes[k];
+        keys[k] = P0 + t * d1 + (0.5f * t * t) * d2;
+    }
+    return true;
+}
+
+/*!
+ * \brief Bound of a tile from the tile tree, no channel data is read
+ */
+void ComputeTileBound(const Bifrost::API::TileAccessor& accessor,
+                      const Bifrost::API::TreeIndex& tindex,
+                      float voxelScale,
+                      Imath::Box3f& bound)
+{
+    amino::Math::vec3f tileMin, tileMax;
+    tile_world_bounds(accessor.tile(tindex).info(),voxelScale,tileMin,tileMax);
+    bound.extendBy(Imath::V3f(tileMin[0],tileMin[1],tileMin[2]));
+    bound.extendBy(Imath::V3f(tileMax[0],tileMax[1],tileMax[2]));
+}
+
+/*!
+ * \brief Largest point radius of the tiles, the constant point radius
+ *        unless a radius channel is used in which case its values are
+ *        bounded by the maxRadius argument
+ */
+float TileMaxRadius(const PointChannels& channels, const ProcArgs& args)
+{
+    if (channels.radius.valid() && args.maxRadius > 0.0f)
+        return args.radiusScale * args.maxRadius;
+    return args.pointRadius;
+}
+
+/*!
+ * \brief Largest displacement of a point moving at the maxSpeed argument
+ *        over the motion keys. Adjacent frame trajectories are not read by
+ *        the root, they are assumed to stay within the unscaled velocity
+ *        displacement
+ */
+float MotionPadding(const ProcArgs& args, const MotionContext& motion)
+{
+    if (motion.keyTimes.size() < 2)
+        return 0.0f;
+    const float keyExtent = std::max(fabsf(motion.keyTimes.front()),fabsf(motion.keyTimes.back()));
+    float velocityScale = fabsf(args.velocityScale);
+    if (args.useAdjacentFrames)
+        velocityScale = std::max(velocityScale, 1.0f);
+    return args.maxSpeed * velocityScale * motion.fps_1 * keyExtent;
+}
+
+/*!
+ * \brief Camera information used by the level of detail metrics
+ */
+struct LodCamera {
+    LodCamera() : valid(false), pixelsPerUnit(0.0f) {}
+    bool valid;
+    Imath::V3f position;
+    float pixelsPerUnit; //!< pixels covered by a unit length at unit distance
+};
+
+/*!
+ * \brief Render camera position and projection scale, invalid when there is
+ *        no camera or no level of detail metric is requested
+ */
+LodCamera GetLodCamera(const ProcArgs& args)
+{
+    LodCamera lodCamera;
+    AtNode *camera = AiUniverseGetCamera();
+    if (!camera || (args.lodDistance <= 0.0f && args.lodMinPixelRadius <= 0.0f))
+        return lodCamera;
+    AtMatrix cameraMatrix;
+    AiNodeGetMatrix(camera,"matrix",cameraMatrix);
+    lodCamera.position = Imath::V3f(cameraMatrix[3][0],cameraMatrix[3][1],cameraMatrix[3][2]);
+    const float fov = AiNodeGetFlt(camera,"fov");
+    const int xres = AiNodeGetInt(AiUniverseGetOptions(),"xres");
+    if (fov > 0.0f)
+        lodCamera.pixelsPerUnit = xres / (2.0f * tanf(0.5f * fov * AI_DTOR));
+    lodCamera.valid = true;
+    return lodCamera;
+}
+
+/*!
+ * \brief Fraction of the points of a tile cluster to keep
+ *
+ * The density fraction is attenuated with the inverse square of the camera
+ * distance beyond lodDistance, and so that points whose projected radius is
+ * under lodMinPixelRadius are thinned out until the radius scaled by
+ * lod_radius_scale() reaches it. lodMinFraction only bounds the camera
+ * attenuation, an explicit smaller density fraction is kept
+ */
+float ComputeLodFraction(const ProcArgs& args,
+                         const LodCamera& lodCamera,
+                         const Imath::Box3f& bound,
+                         float maxRadius)
+{
+    float attenuation = 1.0f;
+    if (lodCamera.valid)
+    {
+        const float distance = std::max((bound.center() - lodCamera.position).length(), 1e-6f);
+        if (args.lodDistance > 0.0f && distance > args.lodDistance)
+            attenuation *= (args.lodDistance * args.lodDistance) / (distance * distance);
+        if (args.lodMinPixelRadius > 0.0f && lodCamera.pixelsPerUnit > 0.0f)
+        {
+            const float pixelRadius = maxRadius * lodCamera.pixelsPerUnit / distance;
+            if (pixelRadius < args.lodMinPixelRadius)
+                attenuation *= (pixelRadius * pixelRadius) / (args.lodMinPixelRadius * args.lodMinPixelRadius);
+        }
+        attenuation = std::max(attenuation, args.lodMinFraction);
+    }
+    return std::min(args.densityFraction * attenuation, 1.0f);
+}
+
+/*!
+ * \brief Create a points node for a single tile
+ */
+void EmitTilePoints(const PointChannels& channels,
+                    const Bifrost::API::TreeIndex& tindex,
+                    const ProcArgs& args,
+                    const MotionContext& motion,
+                    ProcArgs::AtNodePtrContainer& createdNodes)
+{
+    const Bifrost::API::TileData<amino::Math::vec3f>& position_tile_data = channels.position.tileData<amino::Math::vec3f>( tindex );
+    const Bifrost::API::TileData<amino::Math::vec3f>& velocity_tile_data = channels.velocity.tileData<amino::Math::vec3f>( tindex );
+    const bool velocityKeys = motion.keyTimes.size() > 1;
+    if (velocityKeys && position_tile_data.count() != velocity_tile_data.count())
+        return;
+    const size_t pointCount = position_tile_data.count();
+
+    // Stable subset of the tile points, lod is null when every point is kept
+    const float fraction = args.tileFraction;
+    std::vector<size_t> lodIndices;
+    select_lod_points(channels.id,tindex,pointCount,fraction,lodIndices);
+    const size_t *lod = fraction < 1.0f ? (lodIndices.empty() ? 0 : &(lodIndices[0])) : 0;
+    const size_t emitCount = fraction < 1.0f ? lodIndices.size() : pointCount;
+    if (!emitCount)
+        return;
+    const float lodRadiusScale = lod_radius_scale(fraction);
+
+    createdNodes.push_back(AiNode("points"));
+    AtNode *points = createdNodes.back();
+
+    /*!
+     * \remark Motion keys are contiguous in the array memory, key k starts
+     *         k * emitCount elements after the first one, each key is
+     *         written in a single branch free pass over the tile applying
+     *         the voxel to world conversion and the velocity extrapolation
+     */
+    const float voxelScale = channels.voxelScale;
+    const float velocity_step = args.velocityScale * motion.fps_1;
+    const size_t keyCount = motion.keyTimes.size();
+    AtArray *vlistArray = AiArrayAllocate(emitCount,keyCount,AI_TYPE_POINT);
+    float *P = reinterpret_cast<float*>(AiArrayMap(vlistArray));
+    const amino::Math::vec3f *position = position_tile_data.data();
+    const amino::Math::vec3f *velocity = velocity_tile_data.data();
+    for (size_t k=0; k<keyCount; k++ ) {
+        float *Pk = P + 3 * emitCount * k;
+        if (velocityKeys)
+        {
+            const float key_step = velocity_step * motion.keyTimes[k];
+            for (size_t i=0; i<emitCount; i++ ) {
+                const size_t s = lod ? lod[i] : i;
+                for (size_t j=0; j<3; j++ ) {
+                    Pk[3*i+j] = voxelScale * position[s][j] + key_step * velocity[s][j];
+                }
+            }
+        }
+        else
+        {
+            for (size_t i=0; i<emitCount; i++ ) {
+                const size_t s = lod ? lod[i] : i;
+                for (size_t j=0; j<3; j++ ) {
+                    Pk[3*i+j] = voxelScale * position[s][j];
+                }
+            }
+        }
+    }
+    // Points found in the adjacent frames follow their curved trajectory instead
+    if (velocityKeys && (motion.previousFrame || motion.nextFrame) && channels.id.valid())
+    {
+        const Bifrost::API::TileData<uint64_t>& id_tile_data = channels.id.tileData<uint64_t>( tindex );
+        std::vector<Imath::V3f> keys(keyCount);
+        for (size_t i=0; i<emitCount; i++ ) {
+            const size_t s = lod ? lod[i] : i;
+            if (s >= id_tile_data.count())
+                continue;
+            Imath::V3f P0(voxelScale * position[s][0],voxelScale * position[s][1],voxelScale * position[s][2]);
+            if (!EvaluateAdjacentFrameKeys(motion,id_tile_data[s],P0,&(keys[0])))
+                continue;
+            for (size_t k=0; k<keyCount; k++ ) {
+                float *Pk = P + 3 * emitCount * k;
+                Pk[3*i] = keys[k].x;
+                Pk[3*i+1] = keys[k].y;
+                Pk[3*i+2] = keys[k].z;
+            }
+        }
+    }
+    AiArrayUnmap(vlistArray);
+    AiNodeSetArray(points, "points",vlistArray);
+
+    AtArray *radiusArray = 0;
+    const bool radiusPerPoint = channels.radius.valid() && channels.radius.elementCount( tindex ) == pointCount;
+    if (radiusPerPoint)
+    {
+        // Every element of the allocated array is written, the tile sizes match
+        const Bifrost::API::TileData<float>& radius_tile_data = channels.radius.tileData<float>( tindex );
+        const float radiusScale = args.radiusScale * lodRadiusScale;
+        radiusArray = AiArrayAllocate(emitCount,1,AI_TYPE_FLOAT);
+        float *radius = reinterpret_cast<float*>(AiArrayMap(radiusArray));
+        for (size_t i=0; i<emitCount; i++ ) {
+            radius[i] = radiusScale * radius_tile_data[lod ? lod[i] : i];
+        }
+        AiArrayUnmap(radiusArray);
+    }
+    else
+    {
+        // A single radius applies to every point, also when the radius tile does not match the positions
+        radiusArray = AiArrayAllocate(1,1,AI_TYPE_FLOAT);
+        AiArraySetFlt(radiusArray,0,args.pointRadius * lodRadiusScale);
+    }
+    AiNodeSetArray(points, "radius",radiusArray);
+    AiNodeSetInt(points,"mode",args.pointMode);
+
+    for (size_t c=0; c<channels.userData.size(); c++)
+    {
+        const Bifrost::API::Channel& userData_ch = channels.userData[c];
+        std::string userDataName = UserDataName(userData_ch);
+        AtArray *userDataArray = 0;
+        if (userData_ch.dataType() == Bifrost::API::FloatType)
+        {
+            const Bifrost::API::TileData<float>& userData_tile_data = userData_ch.tileData<float>( tindex );
+            if (userData_tile_data.count() != pointCount)
+                continue;
+            AiNodeDeclare(points,userDataName.c_str(),"uniform FLOAT");
+            userDataArray = AiArrayAllocate(emitCount,1,AI_TYPE_FLOAT);
+            float *userData = reinterpret_cast<float*>(AiArrayMap(userDataArray));
+            for (size_t i=0; i<emitCount; i++ ) {
+                userData[i] = userData_tile_data[lod ? lod[i] : i];
+            }
+        }
+        else
+        {
+            const Bifrost::API::TileData<amino::Math::vec3f>& userData_tile_data = userData_ch.tileData<amino::Math::vec3f>( tindex );
+            if (userData_tile_data.count() != pointCount)
+                continue;
+            AiNodeDeclare(points,userDataName.c_str(),"uniform VECTOR");
+            userDataArray = AiArrayAllocate(emitCount,1,AI_TYPE_VECTOR);
+            AtVector *userData = reinterpret_cast<AtVector*>(AiArrayMap(userDataArray));
+            for (size_t i=0; i<emitCount; i++ ) {
+                const size_t s = lod ? lod[i] : i;
+                userData[i].x = userData_tile_data[s][0];
+                userData[i].y = userData_tile_data[s][1];
+                userData[i].z = userData_tile_data[s][2];
+            }
+        }
+        AiArrayUnmap(userDataArray);
+        AiNodeSetArray(points,userDataName.c_str(),userDataArray);
+    }
+}
+
+/*!
+ * \brief Non-root level, emit the points of the tiles
+ *        [bifrostTileIndex, bifrostTileIndex + bifrostTileCount) at bifrostTileDepth
+ */
+bool ProcessBifrostParticleCache(const Bifrost::API::StateServer& ss,
+                                 const ProcArgs& args,
+                                 const MotionContext& motion,
+                                 ProcArgs::AtNodePtrContainer & createdNodes)
+{
+    size_t numComponents = ss.components().count();
+    for (size_t componentIndex=0;componentIndex<numComponents;componentIndex++)
+    {
+        Bifrost::API::Component component = ss.components()[componentIndex];
+        if (component.type() != Bifrost::API::PointComponentType)
+            continue;
+
+        PointChannels channels;
+        if (!GetPointChannels(component,args,channels))
+            continue;
+
+        Bifrost::API::Layout layout = component.layout();
+        size_t tileEnd = std::min(args.bifrostTileIndex + args.bifrostTileCount,
+                                  layout.tileCount(args.bifrostTileDepth));
+        for ( size_t t=args.bifrostTileIndex; t<tileEnd; t++ ) {
+            Bifrost::API::TreeIndex tindex(t,args.bifrostTileDepth);
+            if ( !channels.position.elementCount( tindex ) ) {
+                // nothing there
+                continue;
+            }
+            EmitTilePoints(channels,tindex,args,motion,createdNodes);
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief Root level, create one child procedural per cluster of
+ *        tilesPerProcedural consecutive tiles bounded by their tiles so
+ *        Arnold only expands the clusters rays actually reach
+ * \note The clusters are built from the tile tree alone and padded with
+ *       the maxSpeed and maxRadius arguments, no channel data is read, it
+ *       is left to the children along with the adjacent frames
+ */
+bool EmitBifrostTileProcedurals(const Bifrost::API::StateServer& ss,
+                                const std::string& dataString,
+                                const ProcArgs& args,
+                                const MotionContext& motion,
+                                ProcArgs::AtNodePtrContainer & createdNodes)
+{
+    const char *parentProceduralDSO = AiNodeGetStr(args.proceduralNode,"dso");
+    const char *parentProceduralName = AiNodeGetName(args.proceduralNode);
+    const LodCamera lodCamera = GetLodCamera(args);
+
+    size_t numComponents = ss.components().count();
+    for (size_t componentIndex=0;componentIndex<numComponents;componentIndex++)
+    {
+        Bifrost::API::Component component = ss.components()[componentIndex];
+        if (component.type() != Bifrost::API::PointComponentType)
+            continue;
+
+        PointChannels channels;
+        if (!GetPointChannels(component,args,channels))
+            continue;
+        if (channels.radius.valid() && args.maxRadius <= 0.0f)
+            AiMsgWarning("Bifrost-procedural : No max radius given for the radius channel \"%s\", tile bounds are padded with the point radius",
+                         args.radiusChannelName.c_str());
+        if (motion.keyTimes.size() > 1 && args.maxSpeed <= 0.0f)
+            AiMsgWarning("Bifrost-procedural : No max speed given, tile bounds are not padded for motion blur");
+        const float maxRadius = TileMaxRadius(channels,args);
+        const float motionPadding = MotionPadding(args,motion);
+        // Without ids the subset would change from frame to frame, every point is kept
+        const bool stableIds = channels.id.valid() && channels.id.dataType() == Bifrost::API::UInt64Type;
+        if (!stableIds && (args.densityFraction < 1.0f || lodCamera.valid))
+            AiMsgWarning("Bifrost-procedural : No id64 channel, level of detail is disabled and every point is rendered");
+
+        // iterate over the tile tree at each level
+        Bifrost::API::Layout layout = component.layout();
+        Bifrost::API::TileAccessor accessor = layout.tileAccessor();
+        size_t depthCount = layout.depthCount();
+        for ( size_t d=0; d<depthCount; d++ ) {
+            size_t tcount = layout.tileCount(d);
+            for ( size_t clusterBegin=0; clusterBegin<tcount; clusterBegin+=args.tilesPerProcedural ) {
+                size_t clusterEnd = std::min(clusterBegin + args.tilesPerProcedural, tcount);
+                Imath::Box3f clusterBound;
+                for ( size_t t=clusterBegin; t<clusterEnd; t++ ) {
+                    Bifrost::API::TreeIndex tindex(t,d);
+                    if ( !channels.position.elementCount( tindex ) ) {
+                        // nothing there
+                        continue;
+                    }
+                    ComputeTileBound(accessor,tindex,channels.voxelScale,clusterBound);
+                }
+                if (clusterBound.isEmpty())
+                    continue;
+
+                // Decimated points are enlarged, pad the bound accordingly
+                const float tileFraction = stableIds ? ComputeLodFraction(args,lodCamera,clusterBound,maxRadius) : 1.0f;
+                const float padding = motionPadding + maxRadius * lod_radius_scale(tileFraction);
+                clusterBound.min -= Imath::V3f(padding);
+                clusterBound.max += Imath::V3f(padding);
+
+                createdNodes.push_back(AiNode("procedural"));
+                AtNode *procedural = createdNodes.back();
+                std::string proceduralName = (boost::format("%1%_tile_%2%_%3%") % parentProceduralName % d % clusterBegin).str();
+                AiNodeSetStr(procedural,"name",proceduralName.c_str());
+                AiNodeSetStr(procedural,"dso",parentProceduralDSO);
+                AiNodeSetPnt(procedural,"min",clusterBound.min.x,clusterBound.min.y,clusterBound.min.z);
+                AiNodeSetPnt(procedural,"max",clusterBound.max.x,clusterBound.max.y,clusterBound.max.z);
+                // Defer expansion until a ray hits the bounds
+                AiNodeSetBool(procedural,"load_at_init",false);
+                boost::format formattedDataString =
+                    boost::format(
+                                  "%1%" /* implicitly contains
+                                           --bif,
+                                           --point-radius,
+                                           --velocity-blur
+                                        */
+                                  " --tile-index %2%"
+                                  " --tile-depth %3%"
+                                  " --tile-count %4%"
+                                  " --tile-fraction %5%"
+                                  " --emit")
+                    % dataString.c_str()
+                    % clusterBegin
+                    % d
+                    % (clusterEnd - clusterBegin)
+                    % tileFraction;
+                AiNodeSetStr(procedural,"data",formattedDataString.str().c_str());
+            }
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief Release the files held in ProcCache by a procedural instance
+ */
+void ReleaseCachedFiles(const ProcArgs& args)
+{
+    if (!args.cachedBifrostFilename.empty())
+        ProcCache::release(args.cachedBifrostFilename);
+    if (!args.cachedPreviousFrameFilename.empty())
+        ProcCache::release(args.cachedPreviousFrameFilename);
+    if (!args.cachedNextFrameFilename.empty())
+        ProcCache::release(args.cachedNextFrameFilename);
+}
+
 int ProcInit( struct AtNode *node, void **user_ptr )
 {
-    // printf("ProcInit : 0001\n");
     ProcArgs * args = new ProcArgs();
     args->proceduralNode = node;
 
     const char *parentProceduralDSO = AiNodeGetStr(node,"dso");
     std::string dataString = AiNodeGetStr(node,"data");
-    // printf("ProcInit : 0002 dataString = \"%s\"\n",dataString.c_str());
     if (dataString.size() != 0)
     {
-        // printf("ProcInit : 0010\n");
         const float current_frame = AiNodeGetFlt(AiUniverseGetOptions(), "frame");
-        const float fps_1 = 1.0f/AiNodeGetFlt(AiUniverseGetOptions(), "fps");
+        MotionContext motion;
+        motion.fps_1 = 1.0f/AiNodeGetFlt(AiUniverseGetOptions(), "fps");
 
         std::string parsingDataString = (boost::format("%1% %2%") % parentProceduralDSO % dataString.c_str()).str();
         PI::String2ArgcArgv s2aa(parsingDataString);
         args->processDataStringAsArgcArgv(s2aa.argc(),s2aa.argv());
-        // printf("ProcInit : 0015\n");
         // args->print();
-        // printf("ProcInit : 0016\n");
         std::string bif_filename_format = args->bifrostFilename;
 
         char bif_filename[MAX_BIF_FILENAME_LENGTH];
         uint32_t bif_int_frame_number = static_cast<uint32_t>(floor(current_frame));
         int sprintf_status = sprintf(bif_filename,bif_filename_format.c_str(),bif_int_frame_number);
-        // printf("ProcInit : 0018 bif_filename_format = \"%s\"\n",bif_filename_format.c_str());
 
-        // printf("ProcInit : 0030\n");
+        ComputeMotionKeyTimes(*args,motion.keyTimes);
+
+        std::string previous_bif_filename;
+        std::string next_bif_filename;
+        if (args->useAdjacentFrames && motion.keyTimes.size() > 1)
+        {
+            char adjacent_bif_filename[MAX_BIF_FILENAME_LENGTH];
+            if (bif_int_frame_number > 0)
+            {
+                sprintf(adjacent_bif_filename,bif_filename_format.c_str(),bif_int_frame_number-1);
+                previous_bif_filename = adjacent_bif_filename;
+            }
+            sprintf(adjacent_bif_filename,bif_filename_format.c_str(),bif_int_frame_number+1);
+            next_bif_filename = adjacent_bif_filename;
+        }
+
         /*!
-         * \remark Iterate through each tile in the bifrost file,
-         *         determine the bounds for that tile (including
-         *         velocity blur growth) and generate a procedural
-         *         for that tile of particle data
+         * \remark Shared with the other procedural instances referring to the
+         *         same file. The root only needs the tile tree but the file
+         *         API has no layout only read, children expanding while
+         *         another procedural still holds the file reuse its load
          */
-        // printf("ProcInit : 0031 bif_filename = \"%s\"\n",bif_filename);
-        Bifrost::API::String biffile = bif_filename;
-        Bifrost::API::ObjectModel om;
-        Bifrost::API::FileIO fileio = om.createFileIO( biffile );
-        Bifrost::API::StateServer ss = fileio.load( );
-        if ( !ss.valid() ) {
-            return false;
+        Bifrost::API::StateServer ss = ProcCache::acquire(bif_filename);
+        if (ss.valid())
+            args->cachedBifrostFilename = bif_filename;
+
+        if (ss.valid() && args->performEmission && !previous_bif_filename.empty())
+        {
+            // Adjacent frames are optional, points missing from both fall back to velocity
+            if (ProcCache::acquire(previous_bif_filename).valid())
+            {
+                args->cachedPreviousFrameFilename = previous_bif_filename;
+                motion.previousFrame = ProcCache::idPositions(previous_bif_filename);
+            }
         }
-        size_t proceduralIndex = 0;
-        size_t numComponents = ss.components().count();
-        for (size_t componentIndex=0;componentIndex<numComponents;componentIndex++)
+        if (ss.valid() && args->performEmission && !next_bif_filename.empty())
         {
-            // printf("ProcInit : 0040\n");
-            Bifrost::API::Component component = ss.components()[componentIndex];
-            Bifrost::API::TypeID componentType = component.type();
-            if (componentType == Bifrost::API::PointComponentType)
+            if (ProcCache::acquire(next_bif_filename).valid())
             {
-                // printf("ProcInit : 0050\n");
-                int positionChannelIndex = findChannelIndexViaName(component,"position");
-                int velocityChannelIndex = findChannelIndexViaName(component,"velocity");
-                if (positionChannelIndex>=0)
-                {
-                    // printf("ProcInit : 0060\n");
-                    const Bifrost::API::Channel& position_ch = component.channels()[positionChannelIndex];
-                    const Bifrost::API::Channel& velocity_ch = component.channels()[velocityChannelIndex];
-                    if (position_ch.valid()
-                        &&
-                        (args->enableVelocityMotionBlur?velocity_ch.valid():true) // check conditionally
-                        )
-                    {
-                        // printf("ProcInit : 0070\n");
-                        // iterate over the tile tree at each level
-                        Bifrost::API::Layout layout = component.layout();
-                        size_t depthCount = layout.depthCount();
-                        for ( size_t d=0; d<depthCount; d++ ) {
-                            for ( size_t t=0; t<layout.tileCount(d); t++ ) {
-                                Bifrost::API::TreeIndex tindex(t,d);
-                                if ( !position_ch.elementCount( tindex ) ) {
-                                    // nothing there
-                                    continue;
-                                }
-
-                                if ( position_ch.dataType() == Bifrost::API::FloatV3Type
-                                     &&
-                                     (args->enableVelocityMotionBlur?(velocity_ch.dataType() == Bifrost::API::FloatV3Type):true) // check conditionally
-                                     )
-                                {
-                                    args->createdNodes.push_back(AiNode("points"));
-                                    AtNode *points = args->createdNodes.back();
-                                    const Bifrost::API::TileData<amino::Math::vec3f>& position_tile_data = position_ch.tileData<amino::Math::vec3f>( tindex );
-                                    const Bifrost::API::TileData<amino::Math::vec3f>& velocity_tile_data = velocity_ch.tileData<amino::Math::vec3f>( tindex );
-                                    if (position_tile_data.count() == velocity_tile_data.count())
-                                    {
-                                        std::vector<amino::Math::vec3f> P(position_tile_data.count());
-                                        std::vector<amino::Math::vec3f> PP;
-                                        if (args->enableVelocityMotionBlur)
-                                            PP.resize(position_tile_data.count());
-                                        std::vector<float> radius(position_tile_data.count(),args->pointRadius);
-                                        for (size_t i=0; i<position_tile_data.count(); i++ ) {
-                                            P[i] = position_tile_data[i];
-                                            if (args->enableVelocityMotionBlur)
-                                            {
-                                                PP[i][0] = P[i][0] +  args->velocityScale * fps_1 * velocity_tile_data[i][0];
-                                                PP[i][1] = P[i][1] +  args->velocityScale * fps_1 * velocity_tile_data[i][1];
-                                                PP[i][2] = P[i][2] +  args->velocityScale * fps_1 * velocity_tile_data[i][2];
-                                            }
-                                        }
-                                        if (args->enableVelocityMotionBlur)
-                                        {
-                                            AtArray *vlistArray = 0;
-                                            vlistArray = AiArrayAllocate(P.size(),2,AI_TYPE_POINT);
-                                            
-                                            AiArraySetKey(vlistArray, 0, &(P[0]));
-                                            AiArraySetKey(vlistArray, 1, &(PP[0]));
-                                            AiNodeSetArray(points, "points",vlistArray);
-                                        }
-                                        else
-                                        {
-                                            AiNodeSetArray(points, "points",
-                                                           AiArrayConvert(P.size(),1,AI_TYPE_POINT,&(P[0])));
-                                        }
-                                        AiNodeSetArray(points, "radius",
-                                                       AiArrayConvert(radius.size(),1,AI_TYPE_FLOAT,&(radius[0])));
-                                        AiNodeSetInt(points,"mode",args->pointMode);
-                                        
-                                    }
-                                }
-                                else
-                                {
-                                    AiMsgWarning("Bifrost-procedural : Position channel not of FloatV3Type or velocity channel not of FloatV3Type where velocity motion blur is requested");
-                                }
-                            }
-                        }
-                    }
-                    else
-                    {
-                        AiMsgWarning("Bifrost-procedural : Position channel not found or velocity channel not found where velocity motion blur is requested");
-                    }
-                }
-
+                args->cachedNextFrameFilename = next_bif_filename;
+                motion.nextFrame = ProcCache::idPositions(next_bif_filename);
             }
         }
 
+        if ( !ss.valid() ) {
+            AiMsgWarning("Bifrost-procedural : Unable to load the content of the Bifrost file \"%s\"",bif_filename);
+            ReleaseCachedFiles(*args);
+            delete args;
+            return false;
+        }
+
+        bool status = false;
+        if (args->performEmission)
+        {
+            // Emit Arnold geometry for the tiles assigned by the root procedural
+            status = ProcessBifrostParticleCache(ss,
+                                                 *args,
+                                                 motion,
+                                                 args->createdNodes);
+        }
+        else
+        {
+            status = EmitBifrostTileProcedurals(ss,
+                                                dataString,
+                                                *args,
+                                                motion,
+                                                args->createdNodes);
+            /*!
+             * \remark Only the procedurals that initialise hold a reference,
+             *         the root releases its own in ProcCleanup. Files are
+             *         shared while a child holding them is alive, children
+             *         no ray reaches never load anything
+             */
+        }
+        if (!status)
+        {
+            AiMsgWarning("Bifrost-procedural : Unable to process the content of the Bifrost file \"%s\"",bif_filename);
+            ReleaseCachedFiles(*args);
+            delete args;
+            return false;
+        }
     }
-    
 
     *user_ptr = args;
 
@@ -170,7 +706,9 @@ int ProcInit( struct AtNode *node, void **user_ptr )
 
 int ProcCleanup( void *user_ptr )
 {
-    delete reinterpret_cast<ProcArgs*>( user_ptr );
+    ProcArgs * args = reinterpret_cast<ProcArgs*>( user_ptr );
+    ReleaseCachedFiles(*args);
+    delete args;
 
     return true;
 }
@@ -186,12 +724,12 @@ int ProcNumNodes( void *user_ptr )
 struct AtNode* ProcGetNode(void *user_ptr, int i)
 {
     ProcArgs * args = reinterpret_cast<ProcArgs*>( user_ptr );
-	
+
     if ( i >= 0 && i < (int) args->createdNodes.size() )
     {
         return args->createdNodes[i];
     }
-	
+
     return NULL;
 }
 
@@ -1,7 +1,17 @@
 #include <ri.h>
+#include <rx.h>
 #include <stdlib.h>
+#include <math.h>
 #include <iostream>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <String2ArgcArgv.h>
+#include <OpenEXR/ImathBox.h>
 #include <utils/BifrostUtils.h>
 
 // Bifrost headers - START
@@ -17,6 +27,77 @@
 #include <bifrostapi/bifrost_layout.h>
 // Bifrost headers - END
 
+namespace po = boost::program_options;
+
+//! Lower bound of the fraction of points kept by the detail driven decimation
+const float MIN_DETAIL_FRACTION = 0.01f;
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+RtVoid Subdivide(RtPointer data, RtFloat detail);
+RtVoid Free(RtPointer data);
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+/*!
+ * \brief Loaded Bifrost file, shared by the top level procedural and the
+ *        per tile cluster procedurals it emits
+ */
+struct BifrostProceduralFile
+{
+    std::once_flag loaded;
+    Bifrost::API::ObjectModel om;
+    Bifrost::API::FileIO fileio;
+    Bifrost::API::StateServer ss;
+};
+typedef std::shared_ptr<BifrostProceduralFile> BifrostProceduralFilePtr;
+
+/*!
+ * \brief Load a Bifrost file or share the copy already loaded by another
+ *        procedural of the render, tile cluster procedurals emitted by the
+ *        Maya cache command each name the same file
+ * \return null if the file cannot be loaded
+ */
+BifrostProceduralFilePtr acquire_procedural_file(const std::string& i_bif_filename)
+{
+    typedef std::map<std::string,std::weak_ptr<BifrostProceduralFile> > FileContainer;
+    static std::mutex files_mutex;
+    static FileContainer files;
+
+    BifrostProceduralFilePtr file;
+    {
+        std::lock_guard<std::mutex> lock(files_mutex);
+        file = files[i_bif_filename].lock();
+        if (!file)
+        {
+            file.reset(new BifrostProceduralFile);
+            files[i_bif_filename] = file;
+        }
+    }
+
+    /*!
+     * \remark The files lock is not held while loading, procedurals of the
+     *         same file wait for its single load, other files load in
+     *         parallel
+     */
+    std::call_once(file->loaded, [&file, &i_bif_filename]()
+    {
+        Bifrost::API::String biffile = i_bif_filename.c_str();
+        file->fileio = file->om.createFileIO( biffile );
+        file->ss = file->fileio.load( );
+    });
+    if ( !file->ss.valid() ) {
+        std::lock_guard<std::mutex> lock(files_mutex);
+        FileContainer::iterator iter = files.find(i_bif_filename);
+        if (iter != files.end() && iter->second.lock() == file)
+            files.erase(iter);
+        return BifrostProceduralFilePtr();
+    }
+    return file;
+}
+
 /*!
  * \brief Put everything into a single class for easier memory management
  */
@@ -27,6 +108,17 @@ struct BifrostProceduralParameters
     , enableVelocityMotionBlur(true)
     , velocityScale(1.0f)
     , pointRadius(1.f)
+    , densityFraction(1.0f)
+    , motionKeys(2)
+    , hasFrameTime(false)
+    , frameTime(0.0f)
+    , maxPointsPerPixel(0.0f)
+    , tilesPerProcedural(1)
+    , performEmission(false)
+    , componentIndex(0)
+    , tileIndex(0)
+    , tileDepth(0)
+    , tileCount(0)
     {}
     virtual ~BifrostProceduralParameters() {}
     std::string bifrost_filename;
@@ -34,6 +126,21 @@ struct BifrostProceduralParameters
     bool enableVelocityMotionBlur;
     float velocityScale;
     float pointRadius;
+    float densityFraction; //!< fraction of the points kept per tile, width is scaled to preserve coverage
+    size_t motionKeys; //!< number of motion keys spread over the shutter interval
+    bool hasFrameTime;
+    float frameTime; //!< time of the current frame in the unit of the Shutter option
+    float maxPointsPerPixel; //!< decimate clusters whose point count exceeds detail times this value, 0 disables
+    size_t tilesPerProcedural;
+    std::vector<float> motionSampleTimes; //!< whole frame times of the files of a motion block
+    std::vector<std::string> motionSampleFiles; //!< files whose points are matched by id64 between the keys
+    // Set on the per tile cluster procedurals
+    bool performEmission;
+    BifrostProceduralFilePtr file;
+    size_t componentIndex;
+    size_t tileIndex;
+    size_t tileDepth;
+    size_t tileCount;
 
 };
 
@@ -42,116 +149,473 @@ void EmitGeometry(float radius)
   RiSphere(radius,-radius,radius,360.0f,RI_NULL);
 }
 
-bool process_bifrost(const BifrostProceduralParameters& bifrost_params, RtFloat detail)
+/*!
+ * \brief Parse the procedural option string, a bare filename is accepted
+ *        for compatibility with the original single argument form
+ */
+bool parse_parameters(const std::string& i_param_string,
+                      BifrostProceduralParameters& o_params)
+{
+    try {
+        // The parser expects the program name first
+        std::string parsing_string = (boost::format("bifrost %1%") % i_param_string).str();
+        PI::String2ArgcArgv s2aa(parsing_string);
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            ("bif", po::value<std::string>(&o_params.bifrost_filename),
+             "bifrost filename.")
+            ("fps", po::value<float>(&o_params.fps),
+             "frames per second used for the velocity extrapolation.")
+            ("velocity-scale", po::value<float>(&o_params.velocityScale),
+             "scale the velocity vector.")
+            ("point-radius", po::value<float>(&o_params.pointRadius),
+             "radius for RenderMan point geometry.")
+            ("no-velocity-blur", "disable velocity motion blur.")
+            ("motion-keys", po::value<size_t>(&o_params.motionKeys),
+             "number of motion keys over the shutter interval.")
+            ("frame", po::value<float>(&o_params.frameTime),
+             "time of the current frame in the unit of the Shutter option, defaults to the Frame option.")
+            ("density-fraction", po::value<float>(&o_params.densityFraction),
+             "fraction of the points to render, width is scaled to preserve coverage.")
+            ("max-points-per-pixel", po::value<float>(&o_params.maxPointsPerPixel),
+             "decimate tile clusters with more points per pixel of detail, 0 disables.")
+            ("tile-cluster", po::value<size_t>(&o_params.tilesPerProcedural),
+             "number of bifrost tiles per emitted procedural.")
+            ("component", po::value<size_t>(&o_params.componentIndex),
+             "point component of the tile range to emit.")
+            ("tile-depth", po::value<size_t>(&o_params.tileDepth),
+             "depth of the tile range to emit.")
+            ("tile-index", po::value<size_t>(&o_params.tileIndex),
+             "first tile of the tile range to emit.")
+            ("tile-count", po::value<size_t>(&o_params.tileCount),
+             "emit the points of this many tiles directly instead of splitting the file.")
+            ("motion-sample-time", po::value<std::vector<float> >(&o_params.motionSampleTimes)->composing(),
+             "time of a motion block key, repeated with --motion-sample-file.")
+            ("motion-sample-file", po::value<std::vector<std::string> >(&o_params.motionSampleFiles)->composing(),
+             "bifrost file of a motion block key, its points are matched to the other keys by id64.")
+            ;
+        po::positional_options_description positional;
+        positional.add("bif", 1);
+
+        po::variables_map vm;
+        po::store(po::command_line_parser(s2aa.argc(), s2aa.argv()).options(desc).positional(positional).run(), vm);
+        po::notify(vm);
+
+        if (vm.count("no-velocity-blur")) {
+            o_params.enableVelocityMotionBlur = false;
+        }
+        o_params.hasFrameTime = vm.count("frame") > 0;
+        o_params.densityFraction = std::min(std::max(o_params.densityFraction,0.0f),1.0f);
+        o_params.tilesPerProcedural = std::max(o_params.tilesPerProcedural,size_t(1));
+        // A tile range is emitted directly, its bound was computed by the caller
+        o_params.performEmission = o_params.tileCount > 0;
+        if (o_params.motionSampleTimes.size() != o_params.motionSampleFiles.size())
+        {
+            std::cerr << "Bifrost procedural : --motion-sample-time and --motion-sample-file must be given in pairs" << std::endl;
+            return false;
+        }
+    }
+    catch(std::exception& e) {
+        std::cerr << boost::format("Bifrost procedural : unable to parse \"%1%\" : %2%") % i_param_string % e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief Motion key times evenly spread over the shutter interval of the
+ *        renderer, a single key at the current frame when velocity motion
+ *        blur is disabled
+ *
+ * o_key_times are in the time of the Shutter option, as RiMotionBegin
+ * expects, o_key_offsets are the same keys in frames relative to the frame
+ * time and drive the velocity extrapolation. The frame time is the --frame
+ * parameter, otherwise the Frame option, otherwise 0 for a shutter already
+ * relative to the frame. A closed or missing shutter keeps the keys
+ * spanning one frame from the current one, with a warning.
+ */
+void compute_motion_key_times(const BifrostProceduralParameters& bifrost_params,
+                              std::vector<RtFloat>& o_key_times,
+                              std::vector<RtFloat>& o_key_offsets)
+{
+    o_key_times.clear();
+    o_key_offsets.clear();
+    RtFloat frame_time = 0.0f;
+    RxInfoType_t result_type;
+    RtInt result_count = 0;
+    if (bifrost_params.hasFrameTime)
+        frame_time = bifrost_params.frameTime;
+    else
+    {
+        RtInt frame = 0;
+        if (RxOption("Frame",&frame,sizeof(frame),&result_type,&result_count) == 0 && result_count == 1)
+            frame_time = static_cast<RtFloat>(frame);
+    }
+    if (!bifrost_params.enableVelocityMotionBlur || bifrost_params.motionKeys < 2)
+    {
+        o_key_times.push_back(frame_time);
+        o_key_offsets.push_back(0.0f);
+        return;
+    }
+    RtFloat shutter[2] = {0.0f,0.0f};
+    if (RxOption("Shutter",shutter,sizeof(shutter),&result_type,&result_count) != 0 || result_count != 2)
+    {
+        shutter[0] = shutter[1] = 0.0f;
+    }
+    if (shutter[1] <= shutter[0])
+    {
+        static std::once_flag closed_shutter_warning;
+        std::call_once(closed_shutter_warning, []()
+        {
+            std::cerr << "Bifrost procedural : shutter is closed, velocity motion keys span one frame" << std::endl;
+        });
+        shutter[0] = frame_time;
+        shutter[1] = frame_time + 1.0f;
+    }
+    for (size_t k=0; k<bifrost_params.motionKeys; k++)
+    {
+        const RtFloat key_time = shutter[0] + (shutter[1] - shutter[0]) * k / (bifrost_params.motionKeys - 1);
+        o_key_times.push_back(key_time);
+        o_key_offsets.push_back(key_time - frame_time);
+    }
+}
+
+/*!
+ * \brief Position and velocity channels of a point component, the velocity
+ *        channel is only required when motion keys are emitted
+ */
+bool get_point_channels(const Bifrost::API::Component& component,
+                        bool i_require_velocity,
+                        Bifrost::API::Channel& o_position_ch,
+                        Bifrost::API::Channel& o_velocity_ch,
+                        Bifrost::API::Channel& o_id_ch)
+{
+    int positionChannelIndex = findChannelIndexViaName(component,"position");
+    int velocityChannelIndex = findChannelIndexViaName(component,"velocity");
+    int idChannelIndex = findChannelIndexViaName(component,"id64");
+    if (positionChannelIndex<0 || (i_require_velocity && velocityChannelIndex<0))
+        return false;
+    o_position_ch = component.channels()[positionChannelIndex];
+    if (velocityChannelIndex>=0)
+        o_velocity_ch = component.channels()[velocityChannelIndex];
+    if (idChannelIndex>=0)
+        o_id_ch = component.channels()[idChannelIndex];
+    return ( o_position_ch.dataType() == Bifrost::API::FloatV3Type
+             &&
+             (i_require_velocity?(o_velocity_ch.dataType() == Bifrost::API::FloatV3Type):true) // check conditionally
+             );
+}
+
+/*!
+ * \brief Top level, emit one RiProcedural per cluster of tilesPerProcedural
+ *        consecutive tiles bounded by its tiles (grown by the fastest point
+ *        over the shutter and the point radius) so only the buckets they
+ *        overlap expand them, point positions are not read
+ */
+bool emit_tile_procedurals(const BifrostProceduralParameters& bifrost_params)
 {
     float fps_1 = 1.0f/bifrost_params.fps;
-    Bifrost::API::String biffile = bifrost_params.bifrost_filename.c_str();
-    Bifrost::API::ObjectModel om;
-    Bifrost::API::FileIO fileio = om.createFileIO( biffile );
-    Bifrost::API::StateServer ss = fileio.load( );
-    if ( !ss.valid() ) {
+    std::vector<RtFloat> keyTimes;
+    std::vector<RtFloat> keyOffsets;
+    compute_motion_key_times(bifrost_params,keyTimes,keyOffsets);
+    const bool velocityKeys = keyTimes.size() > 1;
+
+    BifrostProceduralFilePtr file = acquire_procedural_file(bifrost_params.bifrost_filename);
+    if ( !file ) {
         return false;
     }
-    size_t proceduralIndex = 0;
-    size_t numComponents = ss.components().count();
+    size_t numComponents = file->ss.components().count();
     for (size_t componentIndex=0;componentIndex<numComponents;componentIndex++)
     {
-        // printf("ProcInit : 0040\n");
-        Bifrost::API::Component component = ss.components()[componentIndex];
-        Bifrost::API::TypeID componentType = component.type();
-        if (componentType == Bifrost::API::PointComponentType)
+        Bifrost::API::Component component = file->ss.components()[componentIndex];
+        if (component.type() != Bifrost::API::PointComponentType)
+            continue;
+        Bifrost::API::Channel position_ch;
+        Bifrost::API::Channel velocity_ch;
+        Bifrost::API::Channel id_ch;
+        if (!get_point_channels(component,velocityKeys,position_ch,velocity_ch,id_ch))
         {
-            // printf("ProcInit : 0050\n");
-            int positionChannelIndex = findChannelIndexViaName(component,"position");
-            int velocityChannelIndex = findChannelIndexViaName(component,"velocity");
-            if (positionChannelIndex>=0)
-            {
-                // printf("ProcInit : 0060\n");
-                const Bifrost::API::Channel& position_ch = component.channels()[positionChannelIndex];
-                const Bifrost::API::Channel& velocity_ch = component.channels()[velocityChannelIndex];
-                if (position_ch.valid()
-                    &&
-                    (bifrost_params.enableVelocityMotionBlur?velocity_ch.valid():true) // check conditionally
-                    )
-                {
-                    // printf("ProcInit : 0070\n");
-                    // iterate over the tile tree at each level
-                    Bifrost::API::Layout layout = component.layout();
-                    size_t depthCount = layout.depthCount();
-                    for ( size_t d=0; d<depthCount; d++ ) {
-                        for ( size_t t=0; t<layout.tileCount(d); t++ ) {
-                            Bifrost::API::TreeIndex tindex(t,d);
-                            if ( !position_ch.elementCount( tindex ) ) {
-                                // nothing there
-                                continue;
-                            }
-
-                            if ( position_ch.dataType() == Bifrost::API::FloatV3Type
-                                 &&
-                                 (bifrost_params.enableVelocityMotionBlur?(velocity_ch.dataType() == Bifrost::API::FloatV3Type):true) // check conditionally
-                                 )
-                            {
-//                                args->createdNodes.push_back(AiNode("points"));
-//                                AtNode *points = args->createdNodes.back();
-                                const Bifrost::API::TileData<amino::Math::vec3f>& position_tile_data = position_ch.tileData<amino::Math::vec3f>( tindex );
-                                const Bifrost::API::TileData<amino::Math::vec3f>& velocity_tile_data = velocity_ch.tileData<amino::Math::vec3f>( tindex );
-                                if (position_tile_data.count() == velocity_tile_data.count())
-                                {
-                                    std::vector<amino::Math::vec3f> P(position_tile_data.count());
-                                    std::vector<amino::Math::vec3f> PP;
-                                    if (bifrost_params.enableVelocityMotionBlur)
-                                        PP.resize(position_tile_data.count());
-                                    std::vector<float> radius(position_tile_data.count(),bifrost_params.pointRadius);
-                                    for (size_t i=0; i<position_tile_data.count(); i++ ) {
-                                        P[i] = position_tile_data[i];
-                                        if (bifrost_params.enableVelocityMotionBlur)
-                                        {
-                                            PP[i][0] = P[i][0] +  bifrost_params.velocityScale * fps_1 * velocity_tile_data[i][0];
-                                            PP[i][1] = P[i][1] +  bifrost_params.velocityScale * fps_1 * velocity_tile_data[i][1];
-                                            PP[i][2] = P[i][2] +  bifrost_params.velocityScale * fps_1 * velocity_tile_data[i][2];
-                                        }
-                                    }
-                                    if (bifrost_params.enableVelocityMotionBlur)
-                                    {
-                                        // args->pointMode
-                                        RtString point_type("disk");
-                                        RtFloat mbTime[2] = {-0.2f,0.2f};
-                                        RiMotionBeginV(2,mbTime);
-                                        RtFloat width = 2.0f * bifrost_params.pointRadius;
-                                        RiPoints(P.size(),RI_P,&(P[0]),RI_CONSTANTWIDTH,&width,
-                                                "uniform string type",&point_type,
-                                                RI_NULL);
-                                        RiPoints(PP.size(),RI_P,&(PP[0]),RI_CONSTANTWIDTH,&width,
-                                                "uniform string type",&point_type,
-                                                RI_NULL);
-                                        RiMotionEnd();
-                                    }
-                                    else
-                                    {
-                                        // args->pointMode
-                                        RtFloat width = 2.0f * bifrost_params.pointRadius;
-                                        RtString point_type("blobby");
-                                        RiPoints(P.size(),RI_P,&(P[0]),RI_CONSTANTWIDTH,&(width),
-                                                // "uniform string type",&point_type,
-                                                RI_NULL);
-                                    }
-                                }
-                            }
-                            else
-                            {
-                                ;
-//                                AiMsgWarning("Bifrost-procedural : Position channel not of FloatV3Type or velocity channel not of FloatV3Type where velocity motion blur is requested");
-                            }
+            std::cerr << "Bifrost procedural : position channel not found or velocity channel not found where velocity motion blur is requested" << std::endl;
+            continue;
+        }
+
+        // iterate over the tile tree at each level
+        Bifrost::API::Layout layout = component.layout();
+        Bifrost::API::TileAccessor accessor = layout.tileAccessor();
+        const float voxelScale = layout.voxelScale();
+        const float keyExtent = velocityKeys ? std::max(fabsf(keyOffsets.front()),fabsf(keyOffsets.back())) : 0.0f;
+        const float velocity_step = fabsf(bifrost_params.velocityScale) * fps_1 * keyExtent;
+        size_t depthCount = layout.depthCount();
+        for ( size_t d=0; d<depthCount; d++ ) {
+            size_t tcount = layout.tileCount(d);
+            for ( size_t clusterBegin=0; clusterBegin<tcount; clusterBegin+=bifrost_params.tilesPerProcedural ) {
+                size_t clusterEnd = std::min(clusterBegin + bifrost_params.tilesPerProcedural, tcount);
+                Imath::Box3f clusterBound;
+                float maxSpeed2 = 0.0f;
+                for ( size_t t=clusterBegin; t<clusterEnd; t++ ) {
+                    Bifrost::API::TreeIndex tindex(t,d);
+                    if ( !position_ch.elementCount( tindex ) ) {
+                        // nothing there
+                        continue;
+                    }
+                    // The tile tree bounds the points, their positions are left to the cluster procedurals
+                    amino::Math::vec3f tileMin, tileMax;
+                    tile_world_bounds(accessor.tile(tindex).info(),voxelScale,tileMin,tileMax);
+                    clusterBound.extendBy(Imath::V3f(tileMin[0],tileMin[1],tileMin[2]));
+                    clusterBound.extendBy(Imath::V3f(tileMax[0],tileMax[1],tileMax[2]));
+                    if (velocityKeys)
+                    {
+                        const Bifrost::API::TileData<amino::Math::vec3f>& velocity_tile_data = velocity_ch.tileData<amino::Math::vec3f>( tindex );
+                        for (size_t i=0; i<velocity_tile_data.count(); i++ ) {
+                            const amino::Math::vec3f& v = velocity_tile_data[i];
+                            maxSpeed2 = std::max(maxSpeed2, v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
                         }
                     }
                 }
+                if (clusterBound.isEmpty())
+                    continue;
+                const float motionPadding = sqrtf(maxSpeed2) * velocity_step;
+                clusterBound.min -= Imath::V3f(motionPadding);
+                clusterBound.max += Imath::V3f(motionPadding);
+
+                // Decimation only ever enlarges the points, pad for the smallest kept fraction
+                const float paddingRadius = bifrost_params.pointRadius * lod_radius_scale(std::min(bifrost_params.densityFraction, bifrost_params.maxPointsPerPixel > 0.0f ? MIN_DETAIL_FRACTION : 1.0f));
+                RtBound bound = { clusterBound.min.x - paddingRadius, clusterBound.max.x + paddingRadius,
+                                  clusterBound.min.y - paddingRadius, clusterBound.max.y + paddingRadius,
+                                  clusterBound.min.z - paddingRadius, clusterBound.max.z + paddingRadius };
+
+                BifrostProceduralParameters *child_params = new BifrostProceduralParameters(bifrost_params);
+                child_params->performEmission = true;
+                child_params->file = file;
+                child_params->componentIndex = componentIndex;
+                child_params->tileIndex = clusterBegin;
+                child_params->tileDepth = d;
+                child_params->tileCount = clusterEnd - clusterBegin;
+                RiProcedural((RtPointer)child_params,bound,Subdivide,Free);
+            }
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief Positions of the points of every point component of a file,
+ *        ordered by id64 so that they match those of other frames
+ * \return false if a component has no id64 channel
+ */
+bool gather_points_by_id(const BifrostProceduralFile& i_file,
+                         std::vector<uint64_t>& o_ids,
+                         std::vector<amino::Math::vec3f>& o_positions)
+{
+    std::vector<uint64_t> ids;
+    std::vector<amino::Math::vec3f> positions;
+    size_t numComponents = i_file.ss.components().count();
+    for (size_t componentIndex=0;componentIndex<numComponents;componentIndex++)
+    {
+        Bifrost::API::Component component = i_file.ss.components()[componentIndex];
+        if (component.type() != Bifrost::API::PointComponentType)
+            continue;
+        Bifrost::API::Channel position_ch;
+        Bifrost::API::Channel velocity_ch;
+        Bifrost::API::Channel id_ch;
+        if (!get_point_channels(component,false,position_ch,velocity_ch,id_ch))
+            continue;
+        if (!id_ch.valid() || id_ch.dataType() != Bifrost::API::UInt64Type)
+            return false;
+        Bifrost::API::Layout layout = component.layout();
+        const float voxelScale = layout.voxelScale();
+        for ( size_t d=0; d<layout.depthCount(); d++ ) {
+            for ( size_t t=0; t<layout.tileCount(d); t++ ) {
+                Bifrost::API::TreeIndex tindex(t,d);
+                if ( !position_ch.elementCount( tindex ) )
+                    continue;
+                const Bifrost::API::TileData<amino::Math::vec3f>& position_tile_data = position_ch.tileData<amino::Math::vec3f>( tindex );
+                const Bifrost::API::TileData<uint64_t>& id_tile_data = id_ch.tileData<uint64_t>( tindex );
+                if (id_tile_data.count() != position_tile_data.count())
+                    return false;
+                for (size_t i=0; i<position_tile_data.count(); i++ ) {
+                    ids.push_back(id_tile_data[i]);
+                    amino::Math::vec3f p;
+                    for (size_t j=0; j<3; j++ )
+                        p[j] = voxelScale * position_tile_data[i][j];
+                    positions.push_back(p);
+                }
+            }
+        }
+    }
+
+    std::vector<size_t> order(ids.size());
+    for (size_t i=0; i<order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(),order.end(),[&ids](size_t a, size_t b) { return ids[a] < ids[b]; });
+    o_ids.resize(ids.size());
+    o_positions.resize(ids.size());
+    for (size_t i=0; i<order.size(); i++)
+    {
+        o_ids[i] = ids[order[i]];
+        o_positions[i] = positions[order[i]];
+    }
+    return true;
+}
+
+/*!
+ * \brief Emit the points of the motion sample files as one motion block,
+ *        one key per whole frame sample, the positions are the ones stored
+ *        in the files so no velocity is involved
+ * \return false if the files can not be read or their ids do not match
+ */
+bool emit_motion_sample_points(const BifrostProceduralParameters& bifrost_params)
+{
+    const size_t keyCount = bifrost_params.motionSampleFiles.size();
+    std::vector<uint64_t> firstIds;
+    std::vector< std::vector<amino::Math::vec3f> > P(keyCount);
+    for (size_t k=0; k<keyCount; k++)
+    {
+        // Consecutive samples of the same frame share its positions
+        if (k && bifrost_params.motionSampleFiles[k] == bifrost_params.motionSampleFiles[k-1])
+        {
+            P[k] = P[k-1];
+            continue;
+        }
+        BifrostProceduralFilePtr file = acquire_procedural_file(bifrost_params.motionSampleFiles[k]);
+        if (!file)
+            return false;
+        std::vector<uint64_t> ids;
+        if (!gather_points_by_id(*file,ids,P[k]))
+            return false;
+        if (!k)
+            firstIds.swap(ids);
+        else if (ids != firstIds)
+            return false;
+    }
+    if (firstIds.empty())
+        return true;
+
+    std::vector<RtFloat> keyTimes(bifrost_params.motionSampleTimes.begin(),bifrost_params.motionSampleTimes.end());
+    RtFloat width = 2.0f * bifrost_params.pointRadius;
+    RiMotionBeginV(keyCount,&(keyTimes[0]));
+    for (size_t k=0; k<keyCount; k++ ) {
+        RiPoints(firstIds.size(),RI_P,&(P[k][0]),RI_CONSTANTWIDTH,&width,
+                 RI_NULL);
+    }
+    RiMotionEnd();
+    return true;
+}
+
+/*!
+ * \brief Tile cluster level, emit the points of the assigned tiles, detail
+ *        (the raster area of the cluster bound) selects the decimation
+ */
+bool emit_tile_points(const BifrostProceduralParameters& bifrost_params, RtFloat detail)
+{
+    float fps_1 = 1.0f/bifrost_params.fps;
+    std::vector<RtFloat> keyTimes;
+    std::vector<RtFloat> keyOffsets;
+    compute_motion_key_times(bifrost_params,keyTimes,keyOffsets);
+    const bool velocityKeys = keyTimes.size() > 1;
+
+    if (bifrost_params.componentIndex >= bifrost_params.file->ss.components().count())
+        return false;
+    Bifrost::API::Component component = bifrost_params.file->ss.components()[bifrost_params.componentIndex];
+    Bifrost::API::Channel position_ch;
+    Bifrost::API::Channel velocity_ch;
+    Bifrost::API::Channel id_ch;
+    if (!get_point_channels(component,velocityKeys,position_ch,velocity_ch,id_ch))
+        return false;
+
+    Bifrost::API::Layout layout = component.layout();
+    const float voxelScale = layout.voxelScale();
+    size_t tileEnd = std::min(bifrost_params.tileIndex + bifrost_params.tileCount,
+                              layout.tileCount(bifrost_params.tileDepth));
+
+    // Fraction of points kept for the cluster, thinned when it is denser than maxPointsPerPixel on screen
+    float fraction = bifrost_params.densityFraction;
+    if (bifrost_params.maxPointsPerPixel > 0.0f)
+    {
+        size_t clusterPointCount = 0;
+        for ( size_t t=bifrost_params.tileIndex; t<tileEnd; t++ )
+            clusterPointCount += position_ch.elementCount( Bifrost::API::TreeIndex(t,bifrost_params.tileDepth) );
+        const float maxPointCount = std::max(detail,1.0f) * bifrost_params.maxPointsPerPixel;
+        if (clusterPointCount > maxPointCount)
+            fraction *= maxPointCount / clusterPointCount;
+        fraction = std::max(fraction,std::min(bifrost_params.densityFraction,MIN_DETAIL_FRACTION));
+    }
+    // Without ids the subset would change from frame to frame, every point is kept
+    if (fraction < 1.0f && (!id_ch.valid() || id_ch.dataType() != Bifrost::API::UInt64Type))
+    {
+        static std::once_flag missing_id_warning;
+        std::call_once(missing_id_warning, []()
+        {
+            std::cerr << "Bifrost procedural : no id64 channel, level of detail is disabled and every point is rendered" << std::endl;
+        });
+        fraction = 1.0f;
+    }
+    const float pointRadius = bifrost_params.pointRadius * lod_radius_scale(fraction);
+
+    for ( size_t t=bifrost_params.tileIndex; t<tileEnd; t++ ) {
+        Bifrost::API::TreeIndex tindex(t,bifrost_params.tileDepth);
+        if ( !position_ch.elementCount( tindex ) ) {
+            // nothing there
+            continue;
+        }
+        const Bifrost::API::TileData<amino::Math::vec3f>& position_tile_data = position_ch.tileData<amino::Math::vec3f>( tindex );
+        const Bifrost::API::TileData<amino::Math::vec3f>& velocity_tile_data = velocity_ch.tileData<amino::Math::vec3f>( tindex );
+        if (velocityKeys && position_tile_data.count() != velocity_tile_data.count())
+            continue;
+
+        // Stable subset of the tile points, every point when lodIndices is empty
+        std::vector<size_t> lodIndices;
+        select_lod_points(id_ch,tindex,position_tile_data.count(),fraction,lodIndices);
+        const size_t emitCount = fraction < 1.0f ? lodIndices.size() : position_tile_data.count();
+        if (!emitCount)
+            continue;
+
+        /*!
+         * \remark Keys are stored back to back, each one is
+         *         written in a single pass over the tile
+         */
+        const size_t keyCount = keyTimes.size();
+        std::vector<amino::Math::vec3f> P(emitCount * keyCount);
+        for (size_t k=0; k<keyCount; k++ ) {
+            amino::Math::vec3f *Pk = &(P[emitCount * k]);
+            const float key_step = bifrost_params.velocityScale * fps_1 * keyOffsets[k];
+            for (size_t i=0; i<emitCount; i++ ) {
+                const size_t s = fraction < 1.0f ? lodIndices[i] : i;
+                if (velocityKeys)
+                {
+                    for (size_t j=0; j<3; j++ ) {
+                        Pk[i][j] = voxelScale * position_tile_data[s][j] + key_step * velocity_tile_data[s][j];
+                    }
+                }
                 else
                 {
-                    ;
-//                    AiMsgWarning("Bifrost-procedural : Position channel not found or velocity channel not found where velocity motion blur is requested");
+                    for (size_t j=0; j<3; j++ ) {
+                        Pk[i][j] = voxelScale * position_tile_data[s][j];
+                    }
                 }
             }
-
+        }
+        if (keyCount > 1)
+        {
+            // args->pointMode
+            RtString point_type("disk");
+            RiMotionBeginV(keyCount,&(keyTimes[0]));
+            RtFloat width = 2.0f * pointRadius;
+            for (size_t k=0; k<keyCount; k++ ) {
+                RiPoints(emitCount,RI_P,&(P[emitCount * k]),RI_CONSTANTWIDTH,&width,
+                        "uniform string type",&point_type,
+                        RI_NULL);
+            }
+            RiMotionEnd();
+        }
+        else
+        {
+            // args->pointMode
+            RtFloat width = 2.0f * pointRadius;
+            RtString point_type("blobby");
+            RiPoints(emitCount,RI_P,&(P[0]),RI_CONSTANTWIDTH,&(width),
+                    // "uniform string type",&point_type,
+                    RI_NULL);
         }
     }
     return true;
@@ -179,22 +643,45 @@ EXTERN RtVoid Free(RtPointer data);
 
 RtPointer ConvertParameters(RtString paramstr)
 {
-    std::cerr << "ConvertParameters" << std::endl;
     std::string ri_param(paramstr);
-    std::cerr << boost::format("ri_param = \"%1%\"") % ri_param.c_str() << std::endl;
 
     BifrostProceduralParameters *param = new BifrostProceduralParameters();
-    param->bifrost_filename = ri_param;
+    if (!parse_parameters(ri_param,*param))
+    {
+        delete param;
+        return 0;
+    }
     return (RtPointer)param;
 }
 
 RtVoid Subdivide(RtPointer data, RtFloat detail)
 {
-    const BifrostProceduralParameters *param = (BifrostProceduralParameters *)data;
-    std::cerr << boost::format("param->bifrost_filename \"%1%\"") % param->bifrost_filename.c_str() << std::endl;
+    BifrostProceduralParameters *param = (BifrostProceduralParameters *)data;
+    if (!param)
+        return;
 
-    process_bifrost(*param, detail);
+    // Tile range procedurals from the RIB load the file themselves
+    if (param->performEmission && !param->file)
+    {
+        param->file = acquire_procedural_file(param->bifrost_filename);
+        if (!param->file)
+        {
+            std::cerr << boost::format("Bifrost procedural : unable to load \"%1%\"") % param->bifrost_filename.c_str() << std::endl;
+            return;
+        }
+    }
+
+    // Motion block of whole frame samples, velocity blur when the points do not match
+    if (!param->performEmission && param->motionSampleFiles.size() > 1)
+    {
+        if (emit_motion_sample_points(*param))
+            return;
+        std::cerr << boost::format("Bifrost procedural : points of the motion samples of \"%1%\" do not match, using velocity blur") % param->bifrost_filename.c_str() << std::endl;
+    }
 
+    bool status = param->performEmission ? emit_tile_points(*param, detail) : emit_tile_procedurals(*param);
+    if (!status)
+        std::cerr << boost::format("Bifrost procedural : unable to process \"%1%\"") % param->bifrost_filename.c_str() << std::endl;
 }
 
 RtVoid Free(RtPointer data)
@@ -1,5 +1,7 @@
 #include "BifrostUtils.h"
 #include <boost/format.hpp>
+#include <algorithm>
+#include <math.h>
 
 int findChannelIndexViaName(const Bifrost::API::Component& component,
                             const Bifrost::API::String& searchChannelName)
@@ -45,3 +47,151 @@ get_channel(const Bifrost::API::Component& i_component,
     }
     o_status = true;
 }
+
+bool build_point_tiles(Bifrost::API::Component& io_component,
+                       const std::vector<amino::Math::vec3f>& i_voxel_positions,
+                       std::vector<size_t>& o_order,
+                       PointTileRangeContainer& o_tiles)
+{
+    typedef std::pair<uint64_t,size_t> KeyIndexPair;
+
+    // Tile keys are packed as 3 x 21 bits, biased so negative tile coordinates sort correctly
+    const int64_t key_bias = 1 << 20;
+    const uint64_t key_mask = (1 << 21) - 1;
+
+    Bifrost::API::Layout layout = io_component.layout();
+    Bifrost::API::TileAccessor accessor = layout.tileAccessor();
+    Bifrost::API::TileDimInfo tile_dim_info = layout.tileDimInfo(layout.maxDepth());
+    const float tile_voxel_width = tile_dim_info.tileWidth * tile_dim_info.voxelWidth;
+    if (tile_voxel_width <= 0.0f)
+        return false;
+    const float inv_tile_voxel_width = 1.0f / tile_voxel_width;
+
+    size_t numPoints = i_voxel_positions.size();
+    std::vector<KeyIndexPair> keyed_points(numPoints);
+    for (size_t i=0;i<numPoints;i++)
+    {
+        uint64_t tile_key[3];
+        for (int c=0;c<3;c++)
+        {
+            // Tile coordinates outside of the 21 bits of the key would wrap into other tiles
+            const double tile_coordinate = floor(i_voxel_positions[i][c] * inv_tile_voxel_width);
+            if (!(tile_coordinate >= -key_bias && tile_coordinate < key_bias))
+            {
+                std::cerr << boost::format("build_point_tiles() : point %1% at voxel coordinate %2% is out of the tile key range")
+                    % i % i_voxel_positions[i][c] << std::endl;
+                return false;
+            }
+            tile_key[c] = static_cast<uint64_t>(static_cast<int64_t>(tile_coordinate) + key_bias) & key_mask;
+        }
+        keyed_points[i] = KeyIndexPair((tile_key[0] << 42) | (tile_key[1] << 21) | tile_key[2], i);
+    }
+    std::sort(keyed_points.begin(),keyed_points.end());
+
+    o_order.resize(numPoints);
+    o_tiles.clear();
+    size_t begin = 0;
+    while (begin < numPoints)
+    {
+        uint64_t key = keyed_points[begin].first;
+        size_t end = begin;
+        for (;end<numPoints && keyed_points[end].first == key;end++)
+            o_order[end] = keyed_points[end].second;
+
+        // Tiles are addressed by the voxel space coordinates of their corner
+        int ti = static_cast<int>(static_cast<int64_t>((key >> 42) & key_mask) - key_bias);
+        int tj = static_cast<int>(static_cast<int64_t>((key >> 21) & key_mask) - key_bias);
+        int tk = static_cast<int>(static_cast<int64_t>(key & key_mask) - key_bias);
+        PointTileRange tile_range;
+        tile_range.tindex = accessor.addTile(static_cast<int>(ti * tile_voxel_width),
+                                             static_cast<int>(tj * tile_voxel_width),
+                                             static_cast<int>(tk * tile_voxel_width));
+        tile_range.begin = begin;
+        tile_range.end = end;
+        if (!tile_range.tindex.valid())
+        {
+            std::cerr << boost::format("build_point_tiles() : unable to add tile [%1%,%2%,%3%]") % ti % tj % tk << std::endl;
+            return false;
+        }
+        io_component.setElementCount(tile_range.tindex, end - begin);
+        o_tiles.push_back(tile_range);
+        begin = end;
+    }
+    return true;
+}
+
+namespace {
+
+/*!
+ * \brief 64 bit finalizer (splitmix64), spreads sequential ids uniformly
+ */
+inline uint64_t hash_point_id(uint64_t i_id)
+{
+    uint64_t h = i_id + 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+} // anonymous namespace
+
+void select_lod_points(const Bifrost::API::Channel& i_id_channel,
+                       const Bifrost::API::TreeIndex& i_tindex,
+                       size_t i_count,
+                       float i_fraction,
+                       std::vector<size_t>& o_indices)
+{
+    o_indices.clear();
+    if (i_fraction >= 1.0f)
+        return;
+
+    // Compare the top 24 bits of the hash against the fraction
+    const uint64_t threshold = static_cast<uint64_t>(std::max(i_fraction, 0.0f) * (1 << 24));
+    o_indices.reserve(static_cast<size_t>(i_count * i_fraction) + 1);
+    if (i_id_channel.valid() && i_id_channel.dataType() == Bifrost::API::UInt64Type)
+    {
+        const Bifrost::API::TileData<uint64_t>& id_tile_data = i_id_channel.tileData<uint64_t>( i_tindex );
+        for (size_t i=0;i<i_count && i<id_tile_data.count();i++)
+        {
+            if ((hash_point_id(id_tile_data[i]) >> 40) < threshold)
+                o_indices.push_back(i);
+        }
+    }
+    else
+    {
+        for (size_t i=0;i<i_count;i++)
+        {
+            if ((hash_point_id(i) >> 40) < threshold)
+                o_indices.push_back(i);
+        }
+    }
+}
+
+std::string channel_short_name(const std::string& i_channel_name)
+{
+    size_t separator = i_channel_name.rfind('-');
+    if (separator != std::string::npos)
+        return i_channel_name.substr(separator+1);
+    return i_channel_name;
+}
+
+void tile_world_bounds(const Bifrost::API::TileInfo& i_info,
+                       float i_voxel_scale,
+                       amino::Math::vec3f& o_min,
+                       amino::Math::vec3f& o_max)
+{
+    const float tile_world_width = i_info.dimInfo.tileWidth * i_info.dimInfo.voxelWidth * i_voxel_scale;
+    o_min[0] = i_info.i * i_voxel_scale;
+    o_min[1] = i_info.j * i_voxel_scale;
+    o_min[2] = i_info.k * i_voxel_scale;
+    o_max[0] = o_min[0] + tile_world_width;
+    o_max[1] = o_min[1] + tile_world_width;
+    o_max[2] = o_min[2] + tile_world_width;
+}
+
+float lod_radius_scale(float i_fraction)
+{
+    if (i_fraction >= 1.0f || i_fraction <= 0.0f)
+        return 1.0f;
+    return 1.0f / sqrtf(i_fraction);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <BifrostHeaders.h>
+#include <string>
+#include <vector>
 
 int findChannelIndexViaName(const Bifrost::API::Component& component,
                             const Bifrost::API::String& searchChannelName);
@@ -11,3 +13,89 @@ get_channel(const Bifrost::API::Component& i_component,
 			const Bifrost::API::DataType& i_expected_type,
 			Bifrost::API::Channel& channel,
 			bool& o_status);
+
+/*!
+ * \brief Level of detail point selection for a tile
+ *
+ * A point is kept when the hash of its id falls below i_fraction, so the
+ * retained subset is stable across frames and only grows as i_fraction
+ * increases. When i_id_channel is not valid the point index within the
+ * tile is hashed instead. No selection is made when i_fraction >= 1,
+ * o_indices is then left empty and every point should be used
+ */
+void select_lod_points(const Bifrost::API::Channel& i_id_channel,
+                       const Bifrost::API::TreeIndex& i_tindex,
+                       size_t i_count,
+                       float i_fraction,
+                       std::vector<size_t>& o_indices);
+
+/*!
+ * \brief Radius multiplier preserving the projected coverage of points
+ *        decimated to i_fraction
+ */
+float lod_radius_scale(float i_fraction);
+
+/*!
+ * \brief Channel name stripped of its component prefix, Bifrost names the
+ *        channels "<component>-<channel>" e.g. "voxel_liquid-density"
+ */
+std::string channel_short_name(const std::string& i_channel_name);
+
+/*!
+ * \brief World space bounds of a tile computed from its voxel space origin
+ *        and width, no channel data is read
+ */
+void tile_world_bounds(const Bifrost::API::TileInfo& i_info,
+                       float i_voxel_scale,
+                       amino::Math::vec3f& o_min,
+                       amino::Math::vec3f& o_max);
+
+/*!
+ * \brief Contiguous block of spatially sorted points belonging to one tile
+ */
+struct PointTileRange
+{
+    Bifrost::API::TreeIndex tindex;
+    size_t begin;
+    size_t end;
+};
+typedef std::vector<PointTileRange> PointTileRangeContainer;
+
+/*!
+ * \brief Assign points (in voxel space) to leaf tiles of the component's layout
+ *
+ * Points are sorted by tile key so that every tile is a contiguous block of
+ * o_order, the tiles are added to the layout and the component element
+ * count is set per tile. Channel data can then be written in bulk with
+ * set_point_channel_data()
+ */
+bool build_point_tiles(Bifrost::API::Component& io_component,
+                       const std::vector<amino::Math::vec3f>& i_voxel_positions,
+                       std::vector<size_t>& o_order,
+                       PointTileRangeContainer& o_tiles);
+
+/*!
+ * \brief Gather i_values in tile order and write one tile data block per tile
+ */
+template<typename T>
+bool set_point_channel_data(Bifrost::API::Channel& io_channel,
+                            const std::vector<T>& i_values,
+                            const std::vector<size_t>& i_order,
+                            const PointTileRangeContainer& i_tiles)
+{
+    if (i_values.size() != i_order.size())
+        return false;
+
+    std::vector<T> sorted_values(i_order.size());
+    for (size_t i=0;i<i_order.size();i++)
+        sorted_values[i] = i_values[i_order[i]];
+
+    PointTileRangeContainer::const_iterator iter = i_tiles.begin();
+    PointTileRangeContainer::const_iterator eIter = i_tiles.end();
+    for (;iter!=eIter;++iter)
+    {
+        if (!io_channel.setTileData<T>(iter->tindex, iter->end - iter->begin, &(sorted_values[iter->begin])))
+            return false;
+    }
+    return true;
+}